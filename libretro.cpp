@@ -103,8 +103,6 @@ static uint32 VSU_CycleFix;
 
 static uint8 WCR;
 
-static int32 next_vip_ts, next_timer_ts, next_input_ts;
-
 static uint32 IRQ_Asserted;
 
 static INLINE void RecalcIntLevel(void)
@@ -236,6 +234,28 @@ uint16 MDFN_FASTCALL MemRead16(v810_timestamp_t &timestamp, uint32 A)
    return 0;
 }
 
+/* Only used for WRAM, cart RAM and cart ROM(see SetMemReadWord32()) */
+uint32 MDFN_FASTCALL MemRead32(v810_timestamp_t &timestamp, uint32 A)
+{
+   A &= (1 << 27) - 1;
+
+   switch(A >> 24)
+   {
+      case 5:
+         return LoadU32_LE((uint32 *)&WRAM[A & 0xFFFF]);
+      case 6:
+         if(GPRAM)
+            return LoadU32_LE((uint32 *)&GPRAM[A & GPRAM_Mask]);
+         break;
+      case 7:
+         return LoadU32_LE((uint32 *)&GPROM[A & GPROM_Mask]);
+      default:
+         return MemRead16(timestamp, A) | (MemRead16(timestamp, A | 2) << 16);
+   }
+
+   return 0;
+}
+
 void MDFN_FASTCALL MemWrite8(v810_timestamp_t &timestamp, uint32 A, uint8 V)
 {
    A &= (1 << 27) - 1;
@@ -253,10 +273,14 @@ void MDFN_FASTCALL MemWrite8(v810_timestamp_t &timestamp, uint32 A, uint8 V)
          break;
       case 5:
          WRAM[A & 0xFFFF] = V;
+         VB_V810->InvalidateCode(&WRAM[A & 0xFFFF]);
          break;
       case 6:
          if(GPRAM)
+         {
             GPRAM[A & GPRAM_Mask] = V;
+            VB_V810->InvalidateCode(&GPRAM[A & GPRAM_Mask]);
+         }
          break;
 
       case 7:
@@ -284,10 +308,14 @@ void MDFN_FASTCALL MemWrite16(v810_timestamp_t &timestamp, uint32 A, uint16 V)
          break;
       case 5:
          StoreU16_LE((uint16 *)&WRAM[A & 0xFFFF], V);
+         VB_V810->InvalidateCode(&WRAM[A & 0xFFFF]);
          break;
       case 6:
          if(GPRAM)
+         {
             StoreU16_LE((uint16 *)&GPRAM[A & GPRAM_Mask], V);
+            VB_V810->InvalidateCode(&GPRAM[A & GPRAM_Mask]);
+         }
          break;
       case 3:
       case 4:
@@ -297,71 +325,201 @@ void MDFN_FASTCALL MemWrite16(v810_timestamp_t &timestamp, uint32 A, uint16 V)
    }
 }
 
-static void FixNonEvents(void)
+/* Only used for WRAM, cart RAM and cart ROM(see SetMemWriteWord32()) */
+void MDFN_FASTCALL MemWrite32(v810_timestamp_t &timestamp, uint32 A, uint32 V)
+{
+   A &= (1 << 27) - 1;
+
+   switch(A >> 24)
+   {
+      case 5:
+         StoreU32_LE((uint32 *)&WRAM[A & 0xFFFF], V);
+         VB_V810->InvalidateCode(&WRAM[A & 0xFFFF]);
+         VB_V810->InvalidateCode(&WRAM[(A & 0xFFFF) + 2]);
+         break;
+      case 6:
+         if(GPRAM)
+         {
+            StoreU32_LE((uint32 *)&GPRAM[A & GPRAM_Mask], V);
+            VB_V810->InvalidateCode(&GPRAM[A & GPRAM_Mask]);
+            VB_V810->InvalidateCode(&GPRAM[(A & GPRAM_Mask) + 2]);
+         }
+         break;
+      case 7:
+         /* ROM, no writing allowed! */
+         break;
+      default:
+         MemWrite16(timestamp, A, V & 0xFFFF);
+         MemWrite16(timestamp, A | 2, V >> 16);
+         break;
+   }
+}
+
+/* Event scheduler: each device registers an update function for its event type(VB_RegisterEvent()),
+ * and registered events are kept in a binary min-heap on their deadline, so the nearest one is always
+ * EventHeap[0]. */
+typedef struct
 {
-   if(next_vip_ts & 0x40000000)
-      next_vip_ts   = VB_EVENT_NONONO;
+   VB_EventHandler handler;	/* NULL if not registered */
+   int32 next_ts;
+   unsigned int heap_index;
+} VB_Event;
 
-   if(next_timer_ts & 0x40000000)
-      next_timer_ts = VB_EVENT_NONONO;
+static VB_Event Events[VB_EVENT_MAX];
+static int EventHeap[VB_EVENT_MAX];
+static unsigned int EventHeapSize;
 
-   if(next_input_ts & 0x40000000)
-      next_input_ts = VB_EVENT_NONONO;
+/* Ties go to the lower event type, which is the order devices have always been updated in. */
+static INLINE bool EventBefore(const int a, const int b)
+{
+   return Events[a].next_ts < Events[b].next_ts || (Events[a].next_ts == Events[b].next_ts && a < b);
 }
 
-static void EventReset(void)
+static INLINE void EventHeapSwap(const unsigned int i, const unsigned int j)
 {
-   next_vip_ts   = VB_EVENT_NONONO;
-   next_timer_ts = VB_EVENT_NONONO;
-   next_input_ts = VB_EVENT_NONONO;
+   const int tmp = EventHeap[i];
+
+   EventHeap[i] = EventHeap[j];
+   EventHeap[j] = tmp;
+
+   Events[EventHeap[i]].heap_index = i;
+   Events[EventHeap[j]].heap_index = j;
 }
 
-static INLINE int32 CalcNextTS(void)
+static void EventHeapSiftDown(unsigned int i)
+{
+   for(;;)
+   {
+      const unsigned int l = i * 2 + 1;
+      const unsigned int r = l + 1;
+      unsigned int m = i;
+
+      if(l < EventHeapSize && EventBefore(EventHeap[l], EventHeap[m]))
+         m = l;
+      if(r < EventHeapSize && EventBefore(EventHeap[r], EventHeap[m]))
+         m = r;
+
+      if(m == i)
+         break;
+
+      EventHeapSwap(i, m);
+      i = m;
+   }
+}
+
+/* After the deadline of the event at heap position i has changed */
+static void EventHeapFix(unsigned int i)
+{
+   while(i && EventBefore(EventHeap[i], EventHeap[(i - 1) >> 1]))
+   {
+      EventHeapSwap(i, (i - 1) >> 1);
+      i = (i - 1) >> 1;
+   }
+
+   EventHeapSiftDown(i);
+}
+
+/* After any number of deadlines have changed */
+static void EventHeapRebuild(void)
+{
+   for(unsigned int i = EventHeapSize >> 1; i--; )
+      EventHeapSiftDown(i);
+}
+
+static void FixNonEvents(void)
 {
-   int32 next_timestamp = next_vip_ts;
+   for(unsigned int i = 0; i < EventHeapSize; i++)
+   {
+      if(Events[EventHeap[i]].next_ts & 0x40000000)
+         Events[EventHeap[i]].next_ts = VB_EVENT_NONONO;
+   }
 
-   if(next_timestamp > next_timer_ts)
-      next_timestamp  = next_timer_ts;
+   EventHeapRebuild();
+}
 
-   if(next_timestamp > next_input_ts)
-      next_timestamp  = next_input_ts;
+static void EventReset(void)
+{
+   for(unsigned int i = 0; i < VB_EVENT_MAX; i++)
+      Events[i].next_ts = VB_EVENT_NONONO;
 
-   return next_timestamp;
+   EventHeapRebuild();
+}
+
+static INLINE int32 CalcNextTS(void)
+{
+   return EventHeapSize ? Events[EventHeap[0]].next_ts : VB_EVENT_NONONO;
 }
 
 static void RebaseTS(const v810_timestamp_t timestamp)
 {
-   assert(next_vip_ts   > timestamp);
-   assert(next_timer_ts > timestamp);
-   assert(next_input_ts > timestamp);
+   /* Subtracting the same amount from every deadline leaves the heap in order. */
+   for(unsigned int i = 0; i < EventHeapSize; i++)
+   {
+      assert(Events[EventHeap[i]].next_ts > timestamp);
+      Events[EventHeap[i]].next_ts -= timestamp;
+   }
+}
+
+extern "C" void VB_RegisterEvent(const int type, VB_EventHandler handler)
+{
+   assert(type >= 0 && type < VB_EVENT_MAX);
+
+   if(!Events[type].handler)
+   {
+      Events[type].heap_index = EventHeapSize;
+      EventHeap[EventHeapSize++] = type;
+   }
 
-   next_vip_ts   -= timestamp;
-   next_timer_ts -= timestamp;
-   next_input_ts -= timestamp;
+   Events[type].handler = handler;
+   Events[type].next_ts = VB_EVENT_NONONO;
+   EventHeapFix(Events[type].heap_index);
 }
 
 extern "C" void VB_SetEvent(const int type,
       const v810_timestamp_t next_timestamp)
 {
-   if      (type == VB_EVENT_VIP)
-      next_vip_ts = next_timestamp;
-   else if (type == VB_EVENT_TIMER)
-      next_timer_ts = next_timestamp;
-   else if (type == VB_EVENT_INPUT)
-      next_input_ts = next_timestamp;
+   Events[type].next_ts = next_timestamp;
+
+   if(Events[type].handler)
+      EventHeapFix(Events[type].heap_index);
 
    if(next_timestamp < VB_V810->GetEventNT())
       VB_V810->SetEventNT(next_timestamp);
 }
 
+/* The nearest event due by timestamp that isn't in ran(bit per type), or -1 if none. */
+static int NextDueEvent(const v810_timestamp_t timestamp, const uint32 ran)
+{
+   int type = -1;
+
+   for(unsigned int i = 0; i < EventHeapSize; i++)
+   {
+      const int t = EventHeap[i];
+
+      if(!(ran & (1U << t)) && timestamp >= Events[t].next_ts && (type < 0 || EventBefore(t, type)))
+         type = t;
+   }
+
+   return type;
+}
+
 static int32 MDFN_FASTCALL EventHandler(const v810_timestamp_t timestamp)
 {
-   if (timestamp >= next_vip_ts)
-      next_vip_ts = VIP_Update(timestamp);
-   if (timestamp >= next_timer_ts)
-      next_timer_ts = TIMER_Update(timestamp);
-   if (timestamp >= next_input_ts)
-      next_input_ts = VBINPUT_Update(timestamp);
+   /* Everything that's due, nearest first, each event at most once per call.  An update that returns a
+    * deadline not after timestamp stays on top of the heap, so the others due are then looked for past
+    * it; it runs again on the next call, which comes right away. */
+   uint32 ran = 0;
+   int type;
+
+   while(EventHeapSize && timestamp >= Events[type = EventHeap[0]].next_ts)
+   {
+      if((ran & (1U << type)) && (type = NextDueEvent(timestamp, ran)) < 0)
+         break;
+
+      ran |= 1U << type;
+      Events[type].next_ts = Events[type].handler(timestamp);
+      EventHeapFix(Events[type].heap_index);
+   }
 
    return CalcNextTS();
 }
@@ -369,9 +527,13 @@ static int32 MDFN_FASTCALL EventHandler(const v810_timestamp_t timestamp)
 /* Called externally from debug.cpp in some cases. */
 static void ForceEventUpdates(const v810_timestamp_t timestamp)
 {
-   next_vip_ts   = VIP_Update(timestamp);
-   next_timer_ts = TIMER_Update(timestamp);
-   next_input_ts = VBINPUT_Update(timestamp);
+   for(unsigned int i = 0; i < VB_EVENT_MAX; i++)
+   {
+      if(Events[i].handler)
+         Events[i].next_ts = Events[i].handler(timestamp);
+   }
+
+   EventHeapRebuild();
 
    VB_V810->SetEventNT(CalcNextTS());
 }
@@ -430,6 +592,21 @@ static void SettingChanged(const char *name)
       VIP_SetInstantDisplayHack(MDFN_GetSettingB("vb.instant_display_hack"));
    else if(!strcmp(name, "vb.allow_draw_skip"))
       VIP_SetAllowDrawSkip(MDFN_GetSettingB("vb.allow_draw_skip"));
+   else if(!strcmp(name, "vb.idle_loop_skip"))
+   {
+      if(VB_V810)
+         VB_V810->SetIdleLoopSkip(MDFN_GetSettingB("vb.idle_loop_skip"));
+   }
+   else if(!strcmp(name, "vb.fpu_host"))
+   {
+      if(VB_V810)
+         VB_V810->SetFPUHostMath(MDFN_GetSettingB("vb.fpu_host"));
+   }
+   else if(!strcmp(name, "vb.split_eye_drawing"))
+   {
+      if(VB_V810)
+         VIP_SetEyeThread(MDFN_GetSettingB("vb.split_eye_drawing"));
+   }
 }
 
 struct VB_HeaderInfo
@@ -1807,8 +1984,8 @@ static int Load(const uint8_t *data, size_t size)
    VB_V810 = new V810();
    VB_V810->Init(cpu_mode, true);
 
-   VB_V810->SetMemReadHandlers(MemRead8, MemRead16, NULL);
-   VB_V810->SetMemWriteHandlers(MemWrite8, MemWrite16, NULL);
+   VB_V810->SetMemReadHandlers(MemRead8, MemRead16, MemRead32);
+   VB_V810->SetMemWriteHandlers(MemWrite8, MemWrite16, MemWrite32);
 
    VB_V810->SetIOReadHandlers(MemRead8, MemRead16, NULL);
    VB_V810->SetIOWriteHandlers(MemWrite8, MemWrite16, NULL);
@@ -1817,6 +1994,10 @@ static int Load(const uint8_t *data, size_t size)
    {
       VB_V810->SetMemReadBus32(i, false);
       VB_V810->SetMemWriteBus32(i, false);
+
+      /* WRAM, cart RAM and cart ROM(and their mirrors) */
+      VB_V810->SetMemReadWord32(i, (i & 7) >= 5);
+      VB_V810->SetMemWriteWord32(i, (i & 7) >= 5);
    }
 
    Map_Addresses = (uint32_t*)malloc(8192 * 4);
@@ -1826,7 +2007,7 @@ static int Load(const uint8_t *data, size_t size)
       for(uint64 sub_A = 5 << 24; sub_A < (6 << 24); sub_A += 65536)
          Map_Addresses[map_size++] = A + sub_A;
    }
-   WRAM = VB_V810->SetFastMap(Map_Addresses, 65536, map_size, "WRAM");
+   WRAM = VB_V810->SetFastMap(Map_Addresses, 65536, map_size, "WRAM", true);
 
    // Round up the ROM size to 65536(we mirror it a little later)
    GPROM_Mask = (size < 65536) ? (65536 - 1) : (size - 1);
@@ -1838,7 +2019,7 @@ static int Load(const uint8_t *data, size_t size)
          Map_Addresses[map_size++] = A + sub_A;
    }
 
-   GPROM = VB_V810->SetFastMap(Map_Addresses, GPROM_Mask + 1, map_size, "Cart ROM");
+   GPROM = VB_V810->SetFastMap(Map_Addresses, GPROM_Mask + 1, map_size, "Cart ROM", false);
    map_size = 0;
 
    // Mirror ROM images < 64KiB to 64KiB
@@ -1852,7 +2033,7 @@ static int Load(const uint8_t *data, size_t size)
       for(uint64 sub_A = 6 << 24; sub_A < (7 << 24); sub_A += GPRAM_Mask + 1)
          Map_Addresses[map_size++] = A + sub_A;
    }
-   GPRAM = VB_V810->SetFastMap(Map_Addresses, GPRAM_Mask + 1, map_size, "Cart RAM");
+   GPRAM = VB_V810->SetFastMap(Map_Addresses, GPRAM_Mask + 1, map_size, "Cart RAM", true);
 
    if (Map_Addresses)
    {
@@ -1862,10 +2043,35 @@ static int Load(const uint8_t *data, size_t size)
 
    memset(GPRAM, 0, GPRAM_Mask + 1);
 
-   VIP_Init();
+   if(!VIP_Init() && log_cb)
+      log_cb(RETRO_LOG_WARN, "Out of memory for the VIP world cache; drawing without it.\n");
+   VIP_SetCPUFeatures(perf_get_cpu_features_cb ? perf_get_cpu_features_cb() : 0);
+   const bool threaded_drawing = VIP_SetDrawThread(MDFN_GetSettingB("vb.threaded_drawing"));
+
+#ifndef MSB_FIRST
+   /* CHR RAM and DRAM are kept in host byte order for the renderer, so CPU loads and stores can
+    * only bypass VIP_Read/Write*() on little-endian hosts.  0x78000(CHR RAM again) and the
+    * registers still go through them.  With threaded drawing, everything but DRAM loads has to
+    * go through them, to wait for the block being drawn. */
+   if(!threaded_drawing)
+   {
+      uint32 vram_address = 0;
+      VB_V810->SetDataMap(&vram_address, VIP_VRAM_SIZE, 1, VIP_GetVRAM(), true, VIP_GetVRAMDirty(), VIP_VRAM_DIRTY_SHIFT);
+   }
+   else
+   {
+      uint32 dram_address = 0x20000;
+      VB_V810->SetDataMap(&dram_address, 0x20000, 1, VIP_GetVRAM() + 0x20000, false, NULL, 0);
+   }
+#endif
+
    VSU_Init(&sbuf[0], &sbuf[1]);
    VBINPUT_Init();
 
+   VB_RegisterEvent(VB_EVENT_VIP, VIP_Update);
+   VB_RegisterEvent(VB_EVENT_TIMER, TIMER_Update);
+   VB_RegisterEvent(VB_EVENT_INPUT, VBINPUT_Update);
+
    VB3DMode = MDFN_GetSettingUI("vb.3dmode");
    uint32 prescale = MDFN_GetSettingUI("vb.liprescale");
    uint32 sbs_separation = MDFN_GetSettingUI("vb.sidebyside.separation");
@@ -1884,6 +2090,10 @@ static int Load(const uint8_t *data, size_t size)
 
    SettingChanged("vb.input.instant_read_hack");
 
+   SettingChanged("vb.idle_loop_skip");
+   SettingChanged("vb.fpu_host");
+   SettingChanged("vb.split_eye_drawing");
+
    VB_Power();
 
    MDFNMP_Init(32768, ((uint64)1 << 27) / 32768);
@@ -1895,9 +2105,7 @@ static int Load(const uint8_t *data, size_t size)
 
 static void CloseGame(void)
 {
-#if 0
    VIP_Kill();
-#endif
 
 #if 0
    if(GPRAM)
@@ -2217,9 +2425,53 @@ static void check_variables(void)
 
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
    {
-      setting_vb_cpu_emulation = !strcmp(var.value, "accurate") 
-         ? V810_EMU_MODE_ACCURATE 
-         : V810_EMU_MODE_FAST;
+      if (!strcmp(var.value, "accurate"))
+         setting_vb_cpu_emulation = V810_EMU_MODE_ACCURATE;
+      else if (!strcmp(var.value, "jit"))
+         setting_vb_cpu_emulation = V810_EMU_MODE_JIT;
+      else
+         setting_vb_cpu_emulation = V810_EMU_MODE_FAST;
+   }
+
+   var.key = "vb_idle_loop_skip";
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      bool old_idle_loop_skip = setting_vb_idle_loop_skip;
+
+      setting_vb_idle_loop_skip = !strcmp(var.value, "enabled");
+
+      if (old_idle_loop_skip != setting_vb_idle_loop_skip)
+         SettingChanged("vb.idle_loop_skip");
+   }
+
+   var.key = "vb_threaded_drawing";
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      setting_vb_threaded_drawing = !strcmp(var.value, "enabled");
+
+   var.key = "vb_split_eye_drawing";
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      bool old_split_eye_drawing = setting_vb_split_eye_drawing;
+
+      setting_vb_split_eye_drawing = !strcmp(var.value, "enabled");
+
+      if (old_split_eye_drawing != setting_vb_split_eye_drawing)
+         SettingChanged("vb.split_eye_drawing");
+   }
+
+   var.key = "vb_fpu_emulation";
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      bool old_fpu_host = setting_vb_fpu_host;
+
+      setting_vb_fpu_host = strcmp(var.value, "softfloat") != 0;
+
+      if (old_fpu_host != setting_vb_fpu_host)
+         SettingChanged("vb.fpu_host");
    }
 }
 
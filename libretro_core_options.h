@@ -112,14 +112,59 @@ struct retro_core_option_definition option_defs_us[] = {
    {
       "vb_cpu_emulation",
       "CPU emulation  (Restart)",
-      "Choose between faster and accurate (slower) emulation.",
+      "Choose between faster and accurate (slower) emulation. 'jit' recompiles game code to native code on x86-64 hosts for the highest speed, with the same timing as 'fast' except that interrupts can be taken a few instructions later; elsewhere it falls back to 'fast'.",
       {
          { "accurate",      NULL },
          { "fast",      NULL },
+         { "jit",      NULL },
          { NULL, NULL},
       },
       "fast",
    },
+   {
+      "vb_idle_loop_skip",
+      "Idle loop skipping",
+      "Fast-forward short loops that only poll for an interrupt or a hardware status change, saving host CPU time. May slightly change timing. No effect with 'accurate' CPU emulation.",
+      {
+         { "disabled",  NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "vb_fpu_emulation",
+      "FPU emulation",
+      "'host' runs floating-point instructions on the host FPU and only uses the 'softfloat' library for results that need exact exception flags. Both give the same results; 'host' is faster in 3D games. Builds without a strict IEEE host FPU always use 'softfloat'.",
+      {
+         { "host",  NULL },
+         { "softfloat",  NULL },
+         { NULL, NULL },
+      },
+      "host",
+   },
+   {
+      "vb_threaded_drawing",
+      "Threaded drawing (Restart)",
+      "Draw the display on a separate thread, alongside the CPU. Same results; faster on hosts with more than one core, but slower on single-core hosts. No effect on builds without thread support.",
+      {
+         { "disabled",  NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "vb_split_eye_drawing",
+      "Split eye drawing",
+      "Draw the left and right eye images on two threads at once. Same results; faster on hosts with more than one core, but slower on single-core hosts. No effect on builds without thread support.",
+      {
+         { "disabled",  NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
    { NULL, NULL, NULL, { NULL, NULL }, NULL },
 };
 
@@ -128,10 +128,55 @@ struct retro_core_option_definition option_defs_chs[] = {
       {
          { "accurate",      "精确" },
          { "fast",      "快速" },
+         { "jit",      "动态重编译" },
          { NULL, NULL},
       },
       "fast",
    },
+   {
+      "vb_idle_loop_skip",
+      "跳过空闲循环",
+      "快进只轮询中断或硬件状态的短循环，以节省主机CPU时间。可能略微改变时序。在“精确”CPU模拟下无效。",
+      {
+         { "disabled",  NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "vb_fpu_emulation",
+      "FPU模拟",
+      "“主机”使用主机FPU执行浮点指令，仅在需要精确异常标志时使用“softfloat”库。两者结果相同；“主机”在3D游戏中更快。没有严格IEEE主机FPU的版本总是使用“softfloat”。",
+      {
+         { "host",  "主机" },
+         { "softfloat",  NULL },
+         { NULL, NULL },
+      },
+      "host",
+   },
+   {
+      "vb_threaded_drawing",
+      "多线程绘制（需要重启）",
+      "在单独的线程上绘制画面，与CPU并行。结果相同；在多核主机上更快，但在单核主机上更慢。不支持线程的版本无效。",
+      {
+         { "disabled",  NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "vb_split_eye_drawing",
+      "分眼绘制",
+      "在两个线程上同时绘制左眼和右眼图像。结果相同；在多核主机上更快，但在单核主机上更慢。不支持线程的版本无效。",
+      {
+         { "disabled",  NULL },
+         { "enabled",  NULL },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
    { NULL, NULL, NULL, { NULL, NULL }, NULL },
 };
 
@@ -215,10 +260,55 @@ struct retro_core_option_definition option_defs_tr[] = {
       {
          { "accurate",      "doğru" },
          { "fast",      "hızlı" },
+         { "jit",      "dinamik yeniden derleyici" },
          { NULL, NULL},
       },
       "fast",
    },
+   {
+      "vb_idle_loop_skip",
+      "Boşta döngü atlama",
+      "Yalnızca bir kesmeyi veya donanım durumunu bekleyen kısa döngüleri ileri sararak ana bilgisayarın CPU zamanından tasarruf eder. Zamanlamayı biraz değiştirebilir. 'doğru' CPU emülasyonunda etkisizdir.",
+      {
+         { "disabled",  "devre dışı" },
+         { "enabled",  "etkin" },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "vb_fpu_emulation",
+      "FPU emülasyonu",
+      "'ana bilgisayar', kayan nokta komutlarını ana bilgisayarın FPU'sunda çalıştırır ve 'softfloat' kütüphanesini yalnızca kesin istisna bayrakları gereken sonuçlar için kullanır. İkisi de aynı sonuçları verir; 'ana bilgisayar' 3D oyunlarda daha hızlıdır. Katı IEEE FPU'su olmayan derlemeler her zaman 'softfloat' kullanır.",
+      {
+         { "host",  "ana bilgisayar" },
+         { "softfloat",  NULL },
+         { NULL, NULL },
+      },
+      "host",
+   },
+   {
+      "vb_threaded_drawing",
+      "İş parçacıklı çizim (Yeniden başlatma gerekir)",
+      "Ekranı CPU ile birlikte ayrı bir iş parçacığında çizer. Sonuçlar aynıdır; birden fazla çekirdeği olan ana bilgisayarlarda daha hızlı, tek çekirdekli olanlarda daha yavaştır. İş parçacığı desteği olmayan derlemelerde etkisizdir.",
+      {
+         { "disabled",  "devre dışı" },
+         { "enabled",  "etkin" },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
+   {
+      "vb_split_eye_drawing",
+      "Göz başına ayrı çizim",
+      "Sol ve sağ göz görüntülerini aynı anda iki iş parçacığında çizer. Sonuçlar aynıdır; birden fazla çekirdeği olan ana bilgisayarlarda daha hızlı, tek çekirdekli olanlarda daha yavaştır. İş parçacığı desteği olmayan derlemelerde etkisizdir.",
+      {
+         { "disabled",  "devre dışı" },
+         { "enabled",  "etkin" },
+         { NULL, NULL },
+      },
+      "disabled",
+   },
    { NULL, NULL, NULL, { NULL, NULL }, NULL },
 };
 
@@ -34,10 +34,10 @@ these four paragraphs for those parts of this code that are retained.
 | Raises the exceptions specified by `flags'.  Floating-point traps can be
 | defined here if desired.  It is currently not possible for such a trap
 | to substitute a result value.  If traps are not implemented, this routine
-| should be simply `float_exception_flags |= flags;'.
+| should be simply `status->float_exception_flags |= flags;'.
 *----------------------------------------------------------------------------*/
 
-#define float_raise(flags) (float_exception_flags |= (flags))
+#define float_raise(flags, status) ((status)->float_exception_flags |= (flags))
 
 /*----------------------------------------------------------------------------
 | Internal canonical NaN format.
@@ -80,7 +80,7 @@ char float32_is_signaling_nan( float32 a )
 | signaling NaN, the invalid exception is raised.
 *----------------------------------------------------------------------------*/
 
-static float32 propagateFloat32NaN( float32 a, float32 b )
+static float32 propagateFloat32NaN( float32 a, float32 b, float_status *status )
 {
     char aIsNaN          = float32_is_nan( a );
     char aIsSignalingNaN = float32_is_signaling_nan( a );
@@ -89,7 +89,7 @@ static float32 propagateFloat32NaN( float32 a, float32 b )
     a |= 0x00400000;
     b |= 0x00400000;
     if ( aIsSignalingNaN | bIsSignalingNaN )
-	    float_raise( float_flag_invalid );
+	    float_raise( float_flag_invalid, status );
     if ( aIsNaN )
         return ( aIsSignalingNaN & bIsNaN ) ? b : a;
     return b;
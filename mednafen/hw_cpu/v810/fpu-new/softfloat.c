@@ -41,11 +41,6 @@ these four paragraphs for those parts of this code that are retained.
 
 #include "softfloat.h"
 
-/*----------------------------------------------------------------------------
-| Floating-point rounding mode and exception flags.
-*----------------------------------------------------------------------------*/
-int8 float_exception_flags = 0;
-
 /*----------------------------------------------------------------------------
 | Primitive arithmetic functions, including multi-word arithmetic, and
 | division and square root approximations.  (Can be specialized to target if
@@ -131,7 +126,7 @@ static INLINE float32 packFloat32( char zSign, int16 zExp, uint32_t zSig )
 | Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-static float32 roundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig )
+static float32 roundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig, float_status *status )
 {
    char isTiny;
    char roundNearestEven = 1;
@@ -146,7 +141,7 @@ static float32 roundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig )
       {
          // Mednafen hack
          //float_raise( float_flag_overflow | float_flag_inexact );
-         float_raise( float_flag_overflow );
+         float_raise( float_flag_overflow, status );
 
          // Mednafen hack
          zExp -= 192;
@@ -159,11 +154,11 @@ static float32 roundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig )
          zSig = shift32RightJamming( zSig, - zExp);
          zExp = 0;
          roundBits = zSig & 0x7F;
-         if ( isTiny && roundBits ) float_raise( float_flag_underflow );
+         if ( isTiny && roundBits ) float_raise( float_flag_underflow, status );
       }
    }
    if ( roundBits )
-      float_exception_flags |= float_flag_inexact;
+      status->float_exception_flags |= float_flag_inexact;
    zSig = ( zSig + roundIncrement )>>7;
    zSig &= ~ ( ( ( roundBits ^ 0x40 ) == 0 ) & roundNearestEven );
    if ( zSig == 0 )
@@ -181,10 +176,10 @@ static float32 roundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig )
 *----------------------------------------------------------------------------*/
 
 static float32
- normalizeRoundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig )
+ normalizeRoundAndPackFloat32( char zSign, int16 zExp, uint32_t zSig, float_status *status )
 {
    int8 shiftCount = countLeadingZeros32( zSig ) - 1;
-   return roundAndPackFloat32( zSign, zExp - shiftCount, zSig<<shiftCount );
+   return roundAndPackFloat32( zSign, zExp - shiftCount, zSig<<shiftCount, status );
 
 }
 
@@ -194,14 +189,14 @@ static float32
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 int32_to_float32( int32 a )
+float32 int32_to_float32( int32 a, float_status *status )
 {
     char zSign;
 
     if ( a == 0 ) return 0;
     if ( a == (int32_t) 0x80000000 ) return packFloat32( 1, 0x9E, 0 );
     zSign = ( a < 0 );
-    return normalizeRoundAndPackFloat32( zSign, 0x9C, zSign ? - a : a );
+    return normalizeRoundAndPackFloat32( zSign, 0x9C, zSign ? - a : a, status );
 
 }
 
@@ -215,7 +210,7 @@ float32 int32_to_float32( int32 a )
 | largest integer with the same sign as `a' is returned.
 *----------------------------------------------------------------------------*/
 
-int32 float32_to_int32( float32 a )
+int32 float32_to_int32( float32 a, float_status *status )
 {
     uint32_t aSigExtra;
     int32 z;
@@ -226,7 +221,7 @@ int32 float32_to_int32( float32 a )
     if ( 0 <= shiftCount ) {
         if ( 0x9E <= aExp ) {
             if ( a != 0xCF000000 ) {
-                float_raise( float_flag_invalid );
+                float_raise( float_flag_invalid, status );
                 if ( ! aSign || ( ( aExp == 0xFF ) && aSig ) ) {
                     return 0x7FFFFFFF;
                 }
@@ -246,7 +241,7 @@ int32 float32_to_int32( float32 a )
             aSigExtra = aSig<<( shiftCount & 31 );
             z = aSig>>( - shiftCount );
         }
-        if ( aSigExtra ) float_exception_flags |= float_flag_inexact;
+        if ( aSigExtra ) status->float_exception_flags |= float_flag_inexact;
         {
             if ( (int32_t) aSigExtra < 0 ) {
                 ++z;
@@ -269,7 +264,7 @@ int32 float32_to_int32( float32 a )
 | returned.
 *----------------------------------------------------------------------------*/
 
-int32 float32_to_int32_round_to_zero( float32 a )
+int32 float32_to_int32_round_to_zero( float32 a, float_status *status )
 {
    int32 z;
    uint32_t aSig     = extractFloat32Frac( a );
@@ -278,19 +273,19 @@ int32 float32_to_int32_round_to_zero( float32 a )
    int16 shiftCount  = aExp - 0x9E;
    if ( 0 <= shiftCount ) {
       if ( a != 0xCF000000 ) {
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
          if ( ! aSign || ( ( aExp == 0xFF ) && aSig ) ) return 0x7FFFFFFF;
       }
       return (int32_t) 0x80000000;
    }
    else if ( aExp <= 0x7E ) {
-      if ( aExp | aSig ) float_exception_flags |= float_flag_inexact;
+      if ( aExp | aSig ) status->float_exception_flags |= float_flag_inexact;
       return 0;
    }
    aSig = ( aSig | 0x00800000 )<<8;
    z = aSig>>( - shiftCount );
    if ( (uint32_t) ( aSig<<( shiftCount & 31 ) ) ) {
-      float_exception_flags |= float_flag_inexact;
+      status->float_exception_flags |= float_flag_inexact;
    }
    if ( aSign ) z = - z;
    return z;
@@ -303,7 +298,7 @@ int32 float32_to_int32_round_to_zero( float32 a )
 | Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_round_to_int( float32 a )
+float32 float32_round_to_int( float32 a, float_status *status )
 {
     char aSign;
     float32 z;
@@ -311,13 +306,13 @@ float32 float32_round_to_int( float32 a )
     int16 aExp = extractFloat32Exp( a );
     if ( 0x96 <= aExp ) {
         if ( ( aExp == 0xFF ) && extractFloat32Frac( a ) ) {
-            return propagateFloat32NaN( a, a );
+            return propagateFloat32NaN( a, a, status );
         }
         return a;
     }
     if ( aExp <= 0x7E ) {
         if ( (uint32_t) ( a<<1 ) == 0 ) return a;
-        float_exception_flags |= float_flag_inexact;
+        status->float_exception_flags |= float_flag_inexact;
         aSign = extractFloat32Sign( a );
 	if ( ( aExp == 0x7E ) && extractFloat32Frac( a ) )
 		return packFloat32( aSign, 0x7F, 0 );
@@ -333,7 +328,7 @@ float32 float32_round_to_int( float32 a )
 		z &= ~ lastBitMask;
     }
     z &= ~ roundBitsMask;
-    if ( z != a ) float_exception_flags |= float_flag_inexact;
+    if ( z != a ) status->float_exception_flags |= float_flag_inexact;
     return z;
 
 }
@@ -346,7 +341,7 @@ float32 float32_round_to_int( float32 a )
 | Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-static float32 addFloat32Sigs( float32 a, float32 b, char zSign )
+static float32 addFloat32Sigs( float32 a, float32 b, char zSign, float_status *status )
 {
    int16 zExp;
    uint32_t zSig;
@@ -359,7 +354,7 @@ static float32 addFloat32Sigs( float32 a, float32 b, char zSign )
    bSig <<= 6;
    if ( 0 < expDiff ) {
       if ( aExp == 0xFF ) {
-         if ( aSig ) return propagateFloat32NaN( a, b );
+         if ( aSig ) return propagateFloat32NaN( a, b, status );
          return a;
       }
       if ( bExp == 0 )
@@ -372,7 +367,7 @@ static float32 addFloat32Sigs( float32 a, float32 b, char zSign )
    }
    else if ( expDiff < 0 ) {
       if ( bExp == 0xFF ) {
-         if ( bSig ) return propagateFloat32NaN( a, b );
+         if ( bSig ) return propagateFloat32NaN( a, b, status );
          return packFloat32( zSign, 0xFF, 0 );
       }
       if ( aExp == 0 ) {
@@ -386,7 +381,7 @@ static float32 addFloat32Sigs( float32 a, float32 b, char zSign )
    }
    else {
       if ( aExp == 0xFF ) {
-         if ( aSig | bSig ) return propagateFloat32NaN( a, b );
+         if ( aSig | bSig ) return propagateFloat32NaN( a, b, status );
          return a;
       }
       if ( aExp == 0 ) return packFloat32( zSign, 0, ( aSig + bSig )>>6 );
@@ -402,7 +397,7 @@ static float32 addFloat32Sigs( float32 a, float32 b, char zSign )
       ++zExp;
    }
 roundAndPack:
-   return roundAndPackFloat32( zSign, zExp, zSig );
+   return roundAndPackFloat32( zSign, zExp, zSig, status );
 
 }
 
@@ -414,7 +409,7 @@ roundAndPack:
 | Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-static float32 subFloat32Sigs( float32 a, float32 b, char zSign )
+static float32 subFloat32Sigs( float32 a, float32 b, char zSign, float_status *status )
 {
    int16 zExp;
    uint32_t zSig;
@@ -428,8 +423,8 @@ static float32 subFloat32Sigs( float32 a, float32 b, char zSign )
    if ( 0 < expDiff ) goto aExpBigger;
    if ( expDiff < 0 ) goto bExpBigger;
    if ( aExp == 0xFF ) {
-      if ( aSig | bSig ) return propagateFloat32NaN( a, b );
-      float_raise( float_flag_invalid );
+      if ( aSig | bSig ) return propagateFloat32NaN( a, b, status );
+      float_raise( float_flag_invalid, status );
       return float32_default_nan;
    }
    if ( aExp == 0 ) {
@@ -441,7 +436,7 @@ static float32 subFloat32Sigs( float32 a, float32 b, char zSign )
    return packFloat32( 0, 0, 0 );
 bExpBigger:
    if ( bExp == 0xFF ) {
-      if ( bSig ) return propagateFloat32NaN( a, b );
+      if ( bSig ) return propagateFloat32NaN( a, b, status );
       return packFloat32( zSign ^ 1, 0xFF, 0 );
    }
    if ( aExp == 0 ) {
@@ -459,7 +454,7 @@ bBigger:
    goto normalizeRoundAndPack;
 aExpBigger:
    if ( aExp == 0xFF ) {
-      if ( aSig ) return propagateFloat32NaN( a, b );
+      if ( aSig ) return propagateFloat32NaN( a, b, status );
       return a;
    }
    if ( bExp == 0 )
@@ -473,7 +468,7 @@ aBigger:
    zExp = aExp;
 normalizeRoundAndPack:
    --zExp;
-   return normalizeRoundAndPackFloat32( zSign, zExp, zSig );
+   return normalizeRoundAndPackFloat32( zSign, zExp, zSig, status );
 }
 
 /*----------------------------------------------------------------------------
@@ -482,13 +477,13 @@ normalizeRoundAndPack:
 | Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_add( float32 a, float32 b )
+float32 float32_add( float32 a, float32 b, float_status *status )
 {
    char aSign = extractFloat32Sign( a );
    char bSign = extractFloat32Sign( b );
    if ( aSign == bSign )
-      return addFloat32Sigs( a, b, aSign );
-   return subFloat32Sigs( a, b, aSign );
+      return addFloat32Sigs( a, b, aSign, status );
+   return subFloat32Sigs( a, b, aSign, status );
 }
 
 /*----------------------------------------------------------------------------
@@ -497,13 +492,13 @@ float32 float32_add( float32 a, float32 b )
 | for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_sub( float32 a, float32 b )
+float32 float32_sub( float32 a, float32 b, float_status *status )
 {
    char aSign = extractFloat32Sign( a );
    char bSign = extractFloat32Sign( b );
    if ( aSign == bSign )
-      return subFloat32Sigs( a, b, aSign );
-   return addFloat32Sigs( a, b, aSign );
+      return subFloat32Sigs( a, b, aSign, status );
+   return addFloat32Sigs( a, b, aSign, status );
 }
 
 /*----------------------------------------------------------------------------
@@ -512,7 +507,7 @@ float32 float32_sub( float32 a, float32 b )
 | for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_mul( float32 a, float32 b )
+float32 float32_mul( float32 a, float32 b, float_status *status )
 {
    int16 zExp;
    uint32_t zSig0, zSig1;
@@ -526,10 +521,10 @@ float32 float32_mul( float32 a, float32 b )
    if ( aExp == 0xFF )
    {
       if ( aSig || ( ( bExp == 0xFF ) && bSig ) )
-         return propagateFloat32NaN( a, b );
+         return propagateFloat32NaN( a, b, status );
       if ( ( bExp | bSig ) == 0 )
       {
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
          return float32_default_nan;
       }
       return packFloat32( zSign, 0xFF, 0 );
@@ -537,10 +532,10 @@ float32 float32_mul( float32 a, float32 b )
    if ( bExp == 0xFF )
    {
       if ( bSig )
-         return propagateFloat32NaN( a, b );
+         return propagateFloat32NaN( a, b, status );
       if ( ( aExp | aSig ) == 0 )
       {
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
          return float32_default_nan;
       }
       return packFloat32( zSign, 0xFF, 0 );
@@ -567,7 +562,7 @@ float32 float32_mul( float32 a, float32 b )
       zSig0 <<= 1;
       --zExp;
    }
-   return roundAndPackFloat32( zSign, zExp, zSig0 );
+   return roundAndPackFloat32( zSign, zExp, zSig0, status );
 
 }
 
@@ -577,7 +572,7 @@ float32 float32_mul( float32 a, float32 b )
 | IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_div( float32 a, float32 b )
+float32 float32_div( float32 a, float32 b, float_status *status )
 {
    int16 zExp;
    uint32_t zSig, rem0, rem1, term0, term1;
@@ -591,12 +586,12 @@ float32 float32_div( float32 a, float32 b )
    if ( aExp == 0xFF )
    {
       if ( aSig )
-         return propagateFloat32NaN( a, b );
+         return propagateFloat32NaN( a, b, status );
       if ( bExp == 0xFF )
       {
          if ( bSig )
-            return propagateFloat32NaN( a, b );
-         float_raise( float_flag_invalid );
+            return propagateFloat32NaN( a, b, status );
+         float_raise( float_flag_invalid, status );
          return float32_default_nan;
       }
       return packFloat32( zSign, 0xFF, 0 );
@@ -604,7 +599,7 @@ float32 float32_div( float32 a, float32 b )
    if ( bExp == 0xFF )
    {
       if ( bSig )
-         return propagateFloat32NaN( a, b );
+         return propagateFloat32NaN( a, b, status );
       return packFloat32( zSign, 0, 0 );
    }
    if ( bExp == 0 )
@@ -613,10 +608,10 @@ float32 float32_div( float32 a, float32 b )
       {
          if ( ( aExp | aSig ) == 0 )
          {
-            float_raise( float_flag_invalid );
+            float_raise( float_flag_invalid, status );
             return float32_default_nan;
          }
-         float_raise( float_flag_divbyzero );
+         float_raise( float_flag_divbyzero, status );
          return packFloat32( zSign, 0xFF, 0 );
       }
       normalizeFloat32Subnormal( bSig, &bExp, &bSig );
@@ -647,7 +642,7 @@ float32 float32_div( float32 a, float32 b )
       }
       zSig |= ( rem1 != 0 );
    }
-   return roundAndPackFloat32( zSign, zExp, zSig );
+   return roundAndPackFloat32( zSign, zExp, zSig, status );
 }
 
 /*----------------------------------------------------------------------------
@@ -656,7 +651,7 @@ float32 float32_div( float32 a, float32 b )
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_rem( float32 a, float32 b )
+float32 float32_rem( float32 a, float32 b, float_status *status )
 {
    char zSign;
    int16 expDiff;
@@ -671,20 +666,20 @@ float32 float32_rem( float32 a, float32 b )
    if ( aExp == 0xFF )
    {
       if ( aSig || ( ( bExp == 0xFF ) && bSig ) )
-         return propagateFloat32NaN( a, b );
-      float_raise( float_flag_invalid );
+         return propagateFloat32NaN( a, b, status );
+      float_raise( float_flag_invalid, status );
       return float32_default_nan;
    }
    if ( bExp == 0xFF )
    {
-      if ( bSig ) return propagateFloat32NaN( a, b );
+      if ( bSig ) return propagateFloat32NaN( a, b, status );
       return a;
    }
    if ( bExp == 0 )
    {
       if ( bSig == 0 )
       {
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
          return float32_default_nan;
       }
       normalizeFloat32Subnormal( bSig, &bExp, &bSig );
@@ -732,7 +727,7 @@ float32 float32_rem( float32 a, float32 b )
    }
    zSign = ( (int32_t) aSig < 0 );
    if ( zSign ) aSig = - aSig;
-   return normalizeRoundAndPackFloat32( aSign ^ zSign, bExp, aSig );
+   return normalizeRoundAndPackFloat32( aSign ^ zSign, bExp, aSig, status );
 }
 
 /*----------------------------------------------------------------------------
@@ -741,7 +736,7 @@ float32 float32_rem( float32 a, float32 b )
 | Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float32 float32_sqrt( float32 a )
+float32 float32_sqrt( float32 a, float_status *status )
 {
     int16 zExp;
     uint32_t zSig, rem0, rem1, term0, term1;
@@ -749,14 +744,14 @@ float32 float32_sqrt( float32 a )
     int16 aExp    = extractFloat32Exp( a );
     char aSign    = extractFloat32Sign( a );
     if ( aExp == 0xFF ) {
-        if ( aSig ) return propagateFloat32NaN( a, 0 );
+        if ( aSig ) return propagateFloat32NaN( a, 0, status );
         if ( ! aSign ) return a;
-        float_raise( float_flag_invalid );
+        float_raise( float_flag_invalid, status );
         return float32_default_nan;
     }
     if ( aSign ) {
         if ( ( aExp | aSig ) == 0 ) return a;
-        float_raise( float_flag_invalid );
+        float_raise( float_flag_invalid, status );
         return float32_default_nan;
     }
     if ( aExp == 0 ) {
@@ -786,7 +781,7 @@ float32 float32_sqrt( float32 a )
     }
     zSig = shift32RightJamming( zSig, 1);
  roundAndPack:
-    return roundAndPackFloat32( 0, zExp, zSig );
+    return roundAndPackFloat32( 0, zExp, zSig, status );
 
 }
 
@@ -796,14 +791,14 @@ float32 float32_sqrt( float32 a )
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-char float32_eq( float32 a, float32 b )
+char float32_eq( float32 a, float32 b, float_status *status )
 {
    if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
       )
    {
       if ( float32_is_signaling_nan( a ) || float32_is_signaling_nan( b ) )
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
       return 0;
    }
    return ( a == b ) || ( (uint32_t) ( ( a | b )<<1 ) == 0 );
@@ -817,7 +812,7 @@ char float32_eq( float32 a, float32 b )
 | Arithmetic.
 *----------------------------------------------------------------------------*/
 
-char float32_le( float32 a, float32 b )
+char float32_le( float32 a, float32 b, float_status *status )
 {
    char aSign, bSign;
 
@@ -825,7 +820,7 @@ char float32_le( float32 a, float32 b )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
       )
    {
-      float_raise( float_flag_invalid );
+      float_raise( float_flag_invalid, status );
       return 0;
    }
    aSign = extractFloat32Sign( a );
@@ -841,14 +836,14 @@ char float32_le( float32 a, float32 b )
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-char float32_lt( float32 a, float32 b )
+char float32_lt( float32 a, float32 b, float_status *status )
 {
    char aSign, bSign;
 
    if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
       ) {
-      float_raise( float_flag_invalid );
+      float_raise( float_flag_invalid, status );
       return 0;
    }
    aSign = extractFloat32Sign( a );
@@ -865,13 +860,13 @@ char float32_lt( float32 a, float32 b )
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-char float32_eq_signaling( float32 a, float32 b )
+char float32_eq_signaling( float32 a, float32 b, float_status *status )
 {
 
    if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
       ) {
-      float_raise( float_flag_invalid );
+      float_raise( float_flag_invalid, status );
       return 0;
    }
    return ( a == b ) || ( (uint32_t) ( ( a | b )<<1 ) == 0 );
@@ -884,7 +879,7 @@ char float32_eq_signaling( float32 a, float32 b )
 | IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-char float32_le_quiet( float32 a, float32 b )
+char float32_le_quiet( float32 a, float32 b, float_status *status )
 {
    char aSign, bSign;
 
@@ -892,7 +887,7 @@ char float32_le_quiet( float32 a, float32 b )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
       ) {
       if ( float32_is_signaling_nan( a ) || float32_is_signaling_nan( b ) )
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
       return 0;
    }
    aSign = extractFloat32Sign( a );
@@ -909,7 +904,7 @@ char float32_le_quiet( float32 a, float32 b )
 | Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-char float32_lt_quiet( float32 a, float32 b )
+char float32_lt_quiet( float32 a, float32 b, float_status *status )
 {
    char aSign, bSign;
 
@@ -918,7 +913,7 @@ char float32_lt_quiet( float32 a, float32 b )
       )
    {
       if ( float32_is_signaling_nan( a ) || float32_is_signaling_nan( b ) )
-         float_raise( float_flag_invalid );
+         float_raise( float_flag_invalid, status );
       return 0;
    }
    aSign = extractFloat32Sign( a );
@@ -54,7 +54,6 @@ enum {
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE floating-point exception flags.
 *----------------------------------------------------------------------------*/
-extern int8 float_exception_flags;
 enum {
     float_flag_inexact   =  1,
     float_flag_underflow =  2,
@@ -63,39 +62,47 @@ enum {
     float_flag_invalid   = 16
 };
 
+/*----------------------------------------------------------------------------
+| Floating-point state.  Each user(e.g. each emulated CPU) owns one, so that
+| separate instances can run on separate threads.
+*----------------------------------------------------------------------------*/
+typedef struct {
+    int8 float_exception_flags;
+} float_status;
+
 /*----------------------------------------------------------------------------
 | Routine to raise any or all of the software IEC/IEEE floating-point
 | exception flags.
 *----------------------------------------------------------------------------*/
-void float_raise( int8 );
+void float_raise( int8, float_status * );
 
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE integer-to-floating-point conversion routines.
 *----------------------------------------------------------------------------*/
-float32 int32_to_float32( int32 );
+float32 int32_to_float32( int32, float_status * );
 
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE single-precision conversion routines.
 *----------------------------------------------------------------------------*/
-int32 float32_to_int32( float32 );
-int32 float32_to_int32_round_to_zero( float32 );
+int32 float32_to_int32( float32, float_status * );
+int32 float32_to_int32_round_to_zero( float32, float_status * );
 
 /*----------------------------------------------------------------------------
 | Software IEC/IEEE single-precision operations.
 *----------------------------------------------------------------------------*/
-float32 float32_round_to_int( float32 );
-float32 float32_add( float32, float32 );
-float32 float32_sub( float32, float32 );
-float32 float32_mul( float32, float32 );
-float32 float32_div( float32, float32 );
-float32 float32_rem( float32, float32 );
-float32 float32_sqrt( float32 );
-char float32_eq( float32, float32 );
-char float32_le( float32, float32 );
-char float32_lt( float32, float32 );
-char float32_eq_signaling( float32, float32 );
-char float32_le_quiet( float32, float32 );
-char float32_lt_quiet( float32, float32 );
+float32 float32_round_to_int( float32, float_status * );
+float32 float32_add( float32, float32, float_status * );
+float32 float32_sub( float32, float32, float_status * );
+float32 float32_mul( float32, float32, float_status * );
+float32 float32_div( float32, float32, float_status * );
+float32 float32_rem( float32, float32, float_status * );
+float32 float32_sqrt( float32, float_status * );
+char float32_eq( float32, float32, float_status * );
+char float32_le( float32, float32, float_status * );
+char float32_lt( float32, float32, float_status * );
+char float32_eq_signaling( float32, float32, float_status * );
+char float32_le_quiet( float32, float32, float_status * );
+char float32_lt_quiet( float32, float32, float_status * );
 char float32_is_signaling_nan( float32 );
 
 #ifdef __cplusplus
@@ -43,6 +43,8 @@ found freely through public domain sources.
  */
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
 #include <algorithm>
 
 #include <boolean.h>
@@ -54,6 +56,22 @@ found freely through public domain sources.
 #include "v810_opt.h"
 #include "v810_cpu.h"
 
+/* What unmapped FastMap pages point to: it reads as 0, and code running off the end of it hits
+ * the trampoline.  It's never written after this is set up, so all instances share it. */
+static uint8 DummyRegion_Data[V810_FAST_MAP_PSIZE + V810_FAST_MAP_TRAMPOLINE_SIZE];
+
+static struct DummyRegion_Setup
+{
+   DummyRegion_Setup()
+   {
+      for(unsigned int i = V810_FAST_MAP_PSIZE; i < V810_FAST_MAP_PSIZE + V810_FAST_MAP_TRAMPOLINE_SIZE; i += 2)
+      {
+         DummyRegion_Data[i + 0] = 0;
+         DummyRegion_Data[i + 1] = 0x36 << 2;
+      }
+   }
+} DummyRegion_Setup_Instance;
+
 V810::V810()
 {
    MemRead8   = NULL;
@@ -72,10 +90,27 @@ V810::V810()
    IOWrite16  = NULL;
    IOWrite32  = NULL;
 
-   memset(FastMap, 0, sizeof(FastMap));
+   DummyRegion = DummyRegion_Data;
+   for(unsigned int i = 0; i < sizeof(FastMap) / sizeof(FastMap[0]); i++)
+      FastMap[i] = DummyRegion;
+   FastMapRegionCount = 0;
+   ClearDataMap();
+
+   IdleLoopSkip = false;
+   FPUHostMath = false;
+   memset(&FPUStatus, 0, sizeof(FPUStatus));
+   memset(IdleLoopCache, 0, sizeof(IdleLoopCache));
+
+   JIT     = NULL;
+   JITStop = false;
+   JITLink = -1;
+   memset(JITNoCode, 0, sizeof(JITNoCode));
+   memset(JITCodeMap, 0, sizeof(JITCodeMap));
 
    memset(MemReadBus32, 0, sizeof(MemReadBus32));
    memset(MemWriteBus32, 0, sizeof(MemWriteBus32));
+   memset(MemReadWord32, 0, sizeof(MemReadWord32));
+   memset(MemWriteWord32, 0, sizeof(MemWriteWord32));
 
    v810_timestamp = 0;
    next_event_ts = 0x7FFFFFFF;
@@ -134,6 +169,11 @@ INLINE void V810::CacheOpMemStore(v810_timestamp_t &timestamp, uint32 A, uint32
       timestamp += 2;
       MemWrite32(timestamp, A, V);
    }
+   else if(MemWriteWord32[A >> 24])
+   {
+      timestamp += 4;
+      MemWrite32(timestamp, A, V);
+   }
    else
    {
       timestamp += 2;
@@ -153,6 +193,12 @@ INLINE uint32 V810::CacheOpMemLoad(v810_timestamp_t &timestamp, uint32 A)
       return MemRead32(timestamp, A);
    }
 
+   if(MemReadWord32[A >> 24])
+   {
+      timestamp += 4;
+      return MemRead32(timestamp, A);
+   }
+
    timestamp += 2;
    ret        = MemRead16(timestamp, A);
 
@@ -213,7 +259,7 @@ INLINE uint32 V810::RDCACHE(v810_timestamp_t &timestamp, uint32 addr)
          else
          {
             timestamp++;
-            Cache[CI].data[SBI] = MemRead16(timestamp, addr & ~0x3) | ((MemRead16(timestamp, (addr & ~0x3) | 0x2) << 16));
+            Cache[CI].data[SBI] = MemReadWord(timestamp, addr & ~0x3);
          }
          Cache[CI].data_valid[SBI] = true;
       }
@@ -229,7 +275,7 @@ INLINE uint32 V810::RDCACHE(v810_timestamp_t &timestamp, uint32 addr)
       else
       {
          timestamp++;
-         Cache[CI].data[SBI] = MemRead16(timestamp, addr & ~0x3) | ((MemRead16(timestamp, (addr & ~0x3) | 0x2) << 16));
+         Cache[CI].data[SBI] = MemReadWord(timestamp, addr & ~0x3);
       }
       Cache[CI].data_valid[SBI] = true;
       Cache[CI].data_valid[SBI ^ 1] = false;
@@ -285,6 +331,9 @@ void V810::Reset()
 
    in_bstr = false;
 
+   if(JIT)
+      JIT_Flush();
+
    RecalcIPendingCache();
 }
 
@@ -296,28 +345,21 @@ bool V810::Init(V810_Emu_Mode mode, bool vb_mode)
    in_bstr = false;
    in_bstr_to = 0;
 
-   if(mode == V810_EMU_MODE_FAST)
-   {
-      memset(DummyRegion, 0, V810_FAST_MAP_PSIZE);
-
-      for(unsigned int i = V810_FAST_MAP_PSIZE; i < V810_FAST_MAP_PSIZE + V810_FAST_MAP_TRAMPOLINE_SIZE; i += 2)
-      {
-         DummyRegion[i + 0] = 0;
-         DummyRegion[i + 1] = 0x36 << 2;
-      }
-
-      for(uint64 A = 0; A < (1ULL << 32); A += V810_FAST_MAP_PSIZE)
-         FastMap[A / V810_FAST_MAP_PSIZE] = DummyRegion - A;
-   }
+   /* Fall back to the interpreter if the host can't run recompiled code. */
+   if(mode == V810_EMU_MODE_JIT && !JIT_Init())
+      EmuMode = V810_EMU_MODE_FAST;
 
    return true;
 }
 
 void V810::Kill(void)
 {
-   if (FastMapAllocList)
-      free(FastMapAllocList);
-   FastMapAllocList = NULL;
+   JIT_Kill();
+
+   for(unsigned int i = 0; i < FastMapRegionCount; i++)
+      free(FastMapRegions[i].data);
+   FastMapRegionCount = 0;
+   ClearDataMap();
 }
 
 void V810::SetInt(int level)
@@ -326,10 +368,196 @@ void V810::SetInt(int level)
    RecalcIPendingCache();
 }
 
-uint8 *V810::SetFastMap(uint32 addresses[], uint32 length, unsigned int num_addresses, const char *name)
+void V810::SetIdleLoopSkip(bool enable)
+{
+   if(IdleLoopSkip == enable)
+      return;
+
+   IdleLoopSkip = enable;
+
+   /* Recompiled code has the result baked in. */
+   if(JIT)
+      JIT_Flush();
+}
+
+void V810::SetFPUHostMath(bool enable)
+{
+   FPUHostMath = enable;
+}
+
+/* Flags a Bcond condition(0-7, the upper bit only negates) depends on. */
+static const uint8 IdleLoop_CondFlags[8] =
+{
+   PSW_OV, PSW_CY, PSW_Z, PSW_CY | PSW_Z, PSW_S, 0, PSW_S | PSW_OV, PSW_S | PSW_OV | PSW_Z
+};
+
+/* Register and flag usage of one instruction, as far as the idle loop scan is concerned. */
+typedef struct
+{
+   uint32 reads;		/* Register masks; r0 is ignored */
+   uint32 writes;
+   uint32 flags_read;
+   uint32 flags_written;
+   bool exit_branch;		/* Conditional branch; must leave the loop when taken */
+   uint32 target;
+} IdleLoop_Insn;
+
+static bool IdleLoop_Decode(uint32 pc, uint16 tmpop, IdleLoop_Insn *insn)
+{
+   const unsigned op6 = tmpop >> 10;
+   const uint32 r1 = 1U << (tmpop & 0x1F);
+   const uint32 r2 = 1U << ((tmpop >> 5) & 0x1F);
+
+   memset(insn, 0, sizeof(*insn));
+
+   switch(op6)
+   {
+      case MOV:
+      case NOT:
+         insn->reads = r1;
+         insn->writes = r2;
+         break;
+
+      case ADD: case SUB: case CMP: case SHL: case SHR: case SAR:
+      case OR: case AND: case XOR:
+         insn->reads = r1 | r2;
+         insn->writes = (op6 == CMP) ? 0 : r2;
+         break;
+
+      case MOV_I:
+         insn->writes = r2;
+         break;
+
+      case ADD_I: case CMP_I: case SHL_I: case SHR_I: case SAR_I:
+         insn->reads = r2;
+         insn->writes = (op6 == CMP_I) ? 0 : r2;
+         break;
+
+      case SETF:
+         insn->writes = r2;
+         insn->flags_read = IdleLoop_CondFlags[tmpop & 0x7];
+         break;
+
+      case MOVEA: case ADDI: case ORI: case ANDI: case XORI: case MOVHI:
+      case LD_B: case LD_H: case LD_W:
+      case IN_B: case IN_H: case IN_W:
+         insn->reads = r1;
+         insn->writes = r2;
+         break;
+
+      default:
+         if(op6 >= 0x20 && op6 < 0x28)	/* Bcond */
+         {
+            const unsigned cond = (tmpop >> 9) & 0xF;
+
+            if(cond == COND_F)	/* NOP */
+               break;
+
+            /* An unconditional branch would make the rest of the loop dead. */
+            if(cond == COND_T)
+               return false;
+
+            insn->flags_read = IdleLoop_CondFlags[cond & 0x7];
+            insn->exit_branch = true;
+            insn->target = pc + (sign_9(tmpop & 0x1FE) & 0xFFFFFFFE);
+            break;
+         }
+         return false;
+   }
+
+   switch(op6)
+   {
+      case ADD: case SUB: case CMP: case SHL: case SHR: case SAR:
+      case ADD_I: case CMP_I: case SHL_I: case SHR_I: case SAR_I:
+      case ADDI:
+         insn->flags_written = PSW_Z | PSW_S | PSW_OV | PSW_CY;
+         break;
+
+      case OR: case AND: case XOR: case NOT:
+      case ORI: case ANDI: case XORI:
+         insn->flags_written = PSW_Z | PSW_S | PSW_OV;
+         break;
+   }
+
+   insn->reads &= ~1U;
+   insn->writes &= ~1U;
+
+   return true;
+}
+
+/*
+ * A loop can be skipped to the next event if every pass through it does the same thing until an
+ * event changes what it reads: it only loads, computes and branches, and nothing it reads(registers
+ * or flags) was left behind by the previous pass.  Loops outside of cartridge ROM are never
+ * considered, so that a scan result can't go stale.
+ */
+bool V810::IdleLoop_Scan(uint32 loop_pc, uint32 branch_pc)
+{
+   uint32 writes = 0, flags_written = 0;
+   uint32 defined = 0, flags_defined = 0;
+   IdleLoop_Insn insn;
+
+   if(((loop_pc >> 24) & 0x7) != 0x7 || ((branch_pc >> 24) & 0x7) != 0x7)
+      return false;
+
+   if(branch_pc < loop_pc || (branch_pc - loop_pc) > (V810_IDLE_LOOP_MAX_SIZE - 2))
+      return false;
+
+   for(int pass = 0; pass < 2; pass++)
+   {
+      uint32 pc = loop_pc;
+
+      while(pc <= branch_pc)
+      {
+         const uint8 *ptr = FastMapPtr(pc);
+         const uint16 tmpop = LoadU16_LE((uint16 *)ptr);
+         const uint32 size = ((tmpop >> 10) >= 0x28) ? 4 : 2;
+
+         if(pc == branch_pc)
+         {
+            /* The closing branch */
+            if(pass && (IdleLoop_CondFlags[(tmpop >> 9) & 0x7] & flags_written & ~flags_defined))
+               return false;
+            break;
+         }
+
+         if(pc + size > branch_pc || !IdleLoop_Decode(pc, tmpop, &insn))
+            return false;
+
+         if(!pass)
+         {
+            if(insn.exit_branch && insn.target >= loop_pc && insn.target <= branch_pc)
+               return false;
+
+            writes |= insn.writes;
+            flags_written |= insn.flags_written;
+         }
+         else
+         {
+            if(insn.reads & writes & ~defined)
+               return false;
+
+            if(insn.flags_read & flags_written & ~flags_defined)
+               return false;
+
+            defined |= insn.writes;
+            flags_defined |= insn.flags_written;
+         }
+
+         pc += size;
+      }
+   }
+
+   return true;
+}
+
+uint8 *V810::SetFastMap(uint32 addresses[], uint32 length, unsigned int num_addresses, const char *name, bool writable)
 {
    uint8 *ret = NULL;
 
+   if(FastMapRegionCount == V810_FAST_MAP_MAX_REGIONS)
+      return(NULL);
+
    if(!(ret = (uint8 *)malloc(length + V810_FAST_MAP_TRAMPOLINE_SIZE)))
       return(NULL);
 
@@ -342,14 +570,60 @@ uint8 *V810::SetFastMap(uint32 addresses[], uint32 length, unsigned int num_addr
    for(unsigned int i = 0; i < num_addresses; i++)
    {  
       for(uint64 addr = addresses[i]; addr != (uint64)addresses[i] + length; addr += V810_FAST_MAP_PSIZE)
-         FastMap[addr / V810_FAST_MAP_PSIZE] = ret - addresses[i];
+         FastMap[(addr & V810_FAST_MAP_ADDR_MASK) / V810_FAST_MAP_PSIZE] = ret + (addr - addresses[i]);
    }
 
-   FastMapAllocList = ret;
+   FastMapRegions[FastMapRegionCount].data   = ret;
+   FastMapRegions[FastMapRegionCount].length = length;
+   FastMapRegions[FastMapRegionCount].writable = writable;
+   FastMapRegionCount++;
+
+   AddDataMapRegion(addresses, length, num_addresses, ret, writable, true, NULL, 0);
 
    return ret;
 }
 
+bool V810::SetDataMap(uint32 addresses[], uint32 length, unsigned int num_addresses, uint8 *data, bool writable, uint8 *dirty, unsigned int dirty_shift)
+{
+   return AddDataMapRegion(addresses, length, num_addresses, data, writable, false, dirty, dirty_shift);
+}
+
+bool V810::AddDataMapRegion(uint32 addresses[], uint32 length, unsigned int num_addresses, uint8 *data, bool writable, bool code, uint8 *dirty, unsigned int dirty_shift)
+{
+   V810_DataMapRegion *r;
+
+   if(DataMapRegionCount == 1 + V810_DATA_MAP_MAX_REGIONS)
+      return false;
+
+   r              = &DataMapRegions[DataMapRegionCount];
+   r->data        = data;
+   r->dirty       = dirty;
+   r->dirty_shift = dirty_shift;
+   r->writable    = writable;
+   r->code        = code;
+
+   for(unsigned int i = 0; i < num_addresses; i++)
+   {
+      for(uint64 addr = addresses[i]; addr < (uint64)addresses[i] + length; addr += V810_FAST_MAP_PSIZE)
+      {
+         DataMap[(addr & V810_FAST_MAP_ADDR_MASK) / V810_FAST_MAP_PSIZE]      = data + (addr - addresses[i]);
+         DataMapIndex[(addr & V810_FAST_MAP_ADDR_MASK) / V810_FAST_MAP_PSIZE] = DataMapRegionCount;
+      }
+   }
+
+   DataMapRegionCount++;
+
+   return true;
+}
+
+void V810::ClearDataMap(void)
+{
+   memset(DataMap, 0, sizeof(DataMap));
+   memset(DataMapIndex, 0, sizeof(DataMapIndex));
+   memset(&DataMapRegions[0], 0, sizeof(DataMapRegions[0]));
+   DataMapRegionCount = 1;
+}
+
 void V810::SetMemReadBus32(uint8 A, bool value)
 {
    MemReadBus32[A] = value;
@@ -360,6 +634,16 @@ void V810::SetMemWriteBus32(uint8 A, bool value)
    MemWriteBus32[A] = value;
 }
 
+void V810::SetMemReadWord32(uint8 A, bool value)
+{
+   MemReadWord32[A] = value;
+}
+
+void V810::SetMemWriteWord32(uint8 A, bool value)
+{
+   MemWriteWord32[A] = value;
+}
+
 void V810::SetMemReadHandlers(uint8 MDFN_FASTCALL (*read8)(v810_timestamp_t &, uint32), uint16 MDFN_FASTCALL (*read16)(v810_timestamp_t &, uint32), uint32 MDFN_FASTCALL (*read32)(v810_timestamp_t &, uint32))
 {
    MemRead8  = read8;
@@ -465,7 +749,7 @@ INLINE uint32 V810::GetSREG(unsigned int which)
 			    PC = new_pc;								\
 			   else										\
 			   {										\
-			    PC_ptr = &FastMap[(new_pc) >> V810_FAST_MAP_SHIFT][(new_pc)];		\
+			    PC_ptr = FastMapPtr(new_pc);						\
 			    PC_base = PC_ptr - (new_pc);						\
 			   }										\
 			  }
@@ -541,6 +825,21 @@ void V810::Run_Fast(int32 MDFN_FASTCALL (*event_handler)(const v810_timestamp_t
  #undef RB_ADDBT
 }
 
+/* Same as Run_Fast(), but each instruction boundary first tries to run a recompiled block(unless
+ * JITNoCode[] says there's none there). */
+void V810::Run_JIT(int32 MDFN_FASTCALL (*event_handler)(const v810_timestamp_t timestamp))
+{
+ const bool RB_AccurateMode = false;
+
+ #define RB_ADDBT(n,o,p)
+ #define RB_CPUHOOK(n) { if(!IPendingCache && !JIT_HasNoCode() && JIT_Exec(timestamp_rl)) continue; }
+
+ #include "v810_oploop.inc"
+
+ #undef RB_CPUHOOK
+ #undef RB_ADDBT
+}
+
 /*
  * Undefine fast mode defines
  */
@@ -554,6 +853,8 @@ v810_timestamp_t V810::Run(int32 MDFN_FASTCALL (*event_handler)(const v810_times
    {
       if(EmuMode == V810_EMU_MODE_FAST)
          Run_Fast(event_handler);
+      else if(EmuMode == V810_EMU_MODE_JIT)
+         Run_JIT(event_handler);
       else
          Run_Accurate(event_handler);
    }
@@ -578,7 +879,7 @@ void V810::SetPC(uint32 new_pc)
       PC = new_pc;
    else
    {
-      PC_ptr = &FastMap[new_pc >> V810_FAST_MAP_SHIFT][new_pc];
+      PC_ptr = FastMapPtr(new_pc);
       PC_base = PC_ptr - new_pc;
    }
 }
@@ -601,20 +902,61 @@ uint32 V810::GetSR(const unsigned int which)
    return GetSREG(which);
 }
 
-#define BSTR_OP_MOV dst_cache &= ~(1 << dstoff); dst_cache |= ((src_cache >> srcoff) & 1) << dstoff;
-#define BSTR_OP_NOT dst_cache &= ~(1 << dstoff); dst_cache |= (((src_cache >> srcoff) & 1) ^ 1) << dstoff;
+/* Each op combines source bits s(already shifted to line up with the destination) into dst_cache,
+ * for the destination bits set in m. */
+#define BSTR_OP_MOV dst_cache = (dst_cache & ~m) | (s & m);
+#define BSTR_OP_NOT dst_cache = (dst_cache & ~m) | (~s & m);
+
+#define BSTR_OP_XOR dst_cache ^= s & m;
+#define BSTR_OP_OR  dst_cache |= s & m;
+#define BSTR_OP_AND dst_cache &= s | ~m;
+
+#define BSTR_OP_XORN dst_cache ^= ~s & m;
+#define BSTR_OP_ORN  dst_cache |= ~s & m;
+#define BSTR_OP_ANDN dst_cache &= ~(s & m);
+
+static INLINE unsigned int BSTR_CountTrailingZeros(uint32 v)
+{
+#ifdef __GNUC__
+   return __builtin_ctz(v);
+#else
+   unsigned int ret = 0;
 
-#define BSTR_OP_XOR dst_cache ^=    ((src_cache >> srcoff) & 1)      << dstoff;
-#define BSTR_OP_OR  dst_cache |=    ((src_cache >> srcoff) & 1)      << dstoff;
-#define BSTR_OP_AND dst_cache &= ~((((src_cache >> srcoff) & 1) ^ 1) << dstoff);
+   while(!(v & 1))
+   {
+      v >>= 1;
+      ret++;
+   }
+   return ret;
+#endif
+}
 
-#define BSTR_OP_XORN dst_cache  ^= (((src_cache >> srcoff) & 1) ^ 1) << dstoff;
-#define BSTR_OP_ORN  dst_cache |=  (((src_cache >> srcoff) & 1) ^ 1) << dstoff;
-#define BSTR_OP_ANDN dst_cache &= ~(((src_cache >> srcoff) & 1)      << dstoff);
+static INLINE unsigned int BSTR_CountLeadingZeros(uint32 v)
+{
+#ifdef __GNUC__
+   return __builtin_clz(v);
+#else
+   unsigned int ret = 0;
+
+   while(!(v & 0x80000000))
+   {
+      v <<= 1;
+      ret++;
+   }
+   return ret;
+#endif
+}
 
 INLINE uint32 V810::BSTR_RWORD(v810_timestamp_t &timestamp, uint32 A)
 {
    uint32 ret;
+   const uint8 *ptr = DataLoadPtr(A);
+
+   if(ptr)
+   {
+      timestamp += MemReadBus32[A >> 24] ? 2 : 4;
+      return LoadU16_LE((uint16 *)ptr) | ((uint32)LoadU16_LE((uint16 *)(ptr + 2)) << 16);
+   }
 
    if(MemReadBus32[A >> 24])
    {
@@ -632,7 +974,15 @@ INLINE uint32 V810::BSTR_RWORD(v810_timestamp_t &timestamp, uint32 A)
 
 INLINE void V810::BSTR_WWORD(v810_timestamp_t &timestamp, uint32 A, uint32 V)
 {
-   if(MemWriteBus32[A >> 24])
+   uint8 *ptr = DataStorePtr(A, 4);
+
+   if(ptr)
+   {
+      timestamp += MemWriteBus32[A >> 24] ? 2 : 4;
+      StoreU16_LE((uint16 *)ptr, V & 0xFFFF);
+      StoreU16_LE((uint16 *)(ptr + 2), V >> 16);
+   }
+   else if(MemWriteBus32[A >> 24])
    {
       timestamp += 2;
       MemWrite32(timestamp, A, V);
@@ -647,9 +997,77 @@ INLINE void V810::BSTR_WWORD(v810_timestamp_t &timestamp, uint32 A, uint32 V)
    }
 }
 
-#define DO_BSTR(op) { 						\
+/* Whole words of a MOVBSU with both offsets at 0, within the data map; stops where the loop in
+ * DO_BSTR() would, with the same timing.  Returns false if it can't be used. */
+INLINE bool V810::BSTR_MoveWords(v810_timestamp_t &timestamp, uint32 &src, uint32 &dst, uint32 &len)
+{
+   const V810_DataMapRegion *dr = &DataMapRegions[DataMapIndex[(dst & V810_FAST_MAP_ADDR_MASK) >> V810_FAST_MAP_SHIFT]];
+   const uint8 *sp = DataLoadPtr(src);
+   uint8 *dp       = DataLoadPtr(dst);
+   uint32 cost, count;
+
+   if(!sp || !dr->writable)
+      return false;
+
+   cost  = (MemReadBus32[src >> 24] ? 2 : 4) + (MemReadBus32[dst >> 24] ? 2 : 4) + (MemWriteBus32[dst >> 24] ? 2 : 4);
+   count = len >> 5;
+   count = std::min<uint32>(count, (V810_FAST_MAP_PSIZE - (src & (V810_FAST_MAP_PSIZE - 1))) >> 2);
+   count = std::min<uint32>(count, (V810_FAST_MAP_PSIZE - (dst & (V810_FAST_MAP_PSIZE - 1))) >> 2);
+
+   /* The loop checks for an event after each word is written. */
+   if(timestamp < next_event_ts)
+      count = std::min<uint32>(count, (next_event_ts - timestamp + cost - 1) / cost);
+   else
+      count = 1;
+
+   if((uintptr_t)dp > (uintptr_t)sp && (uintptr_t)dp < (uintptr_t)sp + count * 4)
+   {
+      /* Overlapping, so later words read back what was just written. */
+      for(uint32 i = 0; i < count * 4; i++)
+         dp[i] = sp[i];
+   }
+   else
+      memmove(dp, sp, count * 4);
+
+   if(dr->code)
+   {
+      for(uint32 i = 0; i < count * 4; i += 2)
+         InvalidateCode(dp + i);
+   }
+
+   if(dr->dirty)
+   {
+      for(uint32 i = 0; i < count * 4; i += 4)
+         dr->dirty[(dp + i - dr->data) >> dr->dirty_shift] = 1;
+   }
+
+   /* Left as if the last word went through the caches. */
+   src_cache = dst_cache = LoadU16_LE((uint16 *)(dp + count * 4 - 4)) | ((uint32)LoadU16_LE((uint16 *)(dp + count * 4 - 2)) << 16);
+
+   timestamp += count * cost;
+   src += count * 4;
+   dst += count * 4;
+   len -= count * 32;
+
+   return true;
+}
+
+/* Works on up to a word at a time, stopping at the end of the source word or the destination word,
+ * so memory is accessed in the same order and with the same timing as one bit at a time. */
+#define DO_BSTR(op, move_words) { 				\
                 while(len)					\
                 {						\
+                 uint32 n, m, s;				\
+								\
+                 if(move_words && !srcoff && !dstoff && len >= 32 && \
+                    !have_src_cache && !have_dst_cache &&	\
+                    BSTR_MoveWords(timestamp, src, dst, len))	\
+                 {                                              \
+                  if(timestamp >= next_event_ts)		\
+                    break;					\
+                  continue;					\
+                 }                                              \
+								\
                  if(!have_src_cache)                            \
                  {                                              \
 		  have_src_cache = true;			\
@@ -662,10 +1080,15 @@ INLINE void V810::BSTR_WWORD(v810_timestamp_t &timestamp, uint32 A, uint32 V)
                   dst_cache = BSTR_RWORD(timestamp, dst);       \
                  }                                              \
 								\
+                 n = 32 - std::max<uint32>(srcoff, dstoff);	\
+                 if(n > len)					\
+                  n = len;					\
+                 m = (uint32)(((uint64)1 << n) - 1) << dstoff;	\
+                 s = (src_cache >> srcoff) << dstoff;		\
 		 op;						\
-                 srcoff = (srcoff + 1) & 0x1F;			\
-                 dstoff = (dstoff + 1) & 0x1F;			\
-		 len--;						\
+                 srcoff = (srcoff + n) & 0x1F;			\
+                 dstoff = (dstoff + n) & 0x1F;			\
+		 len -= n;					\
 								\
 		 if(!srcoff)					\
 		 {                                              \
@@ -696,6 +1119,8 @@ INLINE bool V810::Do_BSTR_Search(v810_timestamp_t &timestamp, const int inc_mul,
 
    while (len)
    {
+      uint32 n, bits;
+
       if (!have_src_cache)
       {
          have_src_cache = true;
@@ -703,10 +1128,40 @@ INLINE bool V810::Do_BSTR_Search(v810_timestamp_t &timestamp, const int inc_mul,
          src_cache = BSTR_RWORD(timestamp, src);
       }
 
-      if(((src_cache >> srcoff) & 1) == bit_test)
+      /* Look at the bits up to where the word is left behind; matching bits are set in "bits". */
+      bits = bit_test ? src_cache : ~src_cache;
+
+      if(inc_mul > 0)
+      {
+         /* srcoff up to 31 */
+         n = std::min<uint32>(32 - srcoff, len);
+         bits = (bits >> srcoff) & (uint32)(((uint64)1 << n) - 1);
+
+         if(bits)
+         {
+            n = BSTR_CountTrailingZeros(bits);
+            found = true;
+         }
+      }
+      else
       {
-         found = true;
+         /* srcoff down to 1; bit 0 is looked at on its own, and is followed by bit 31 of the same word. */
+         n = std::min<uint32>(srcoff ? srcoff : 1, len);
+         bits = (bits << (31 - srcoff)) & ~(0xFFFFFFFF >> n);
+
+         if(bits)
+         {
+            n = BSTR_CountLeadingZeros(bits);
+            found = true;
+         }
+      }
+
+      srcoff = (srcoff + inc_mul * n) & 0x1F;
+      bits_skipped += n;
+      len -= n;
 
+      if(found)
+      {
          /* Fix the bit offset and word address to "1 bit before" it was found */
          srcoff -= inc_mul * 1;
          if(srcoff & 0x20)		/* Handles 0x1F->0x20(0x00) and 0x00->0xFFFF... */
@@ -716,9 +1171,6 @@ INLINE bool V810::Do_BSTR_Search(v810_timestamp_t &timestamp, const int inc_mul,
          }
          break;
       }
-      srcoff = (srcoff + inc_mul * 1) & 0x1F;
-      bits_skipped++;
-      len--;
 
       if(!srcoff)
       {
@@ -769,35 +1221,35 @@ bool V810::bstr_subop(v810_timestamp_t &timestamp, int sub_op, int arg1)
       switch(sub_op)
       {
          case ORBSU:
-            DO_BSTR(BSTR_OP_OR);
+            DO_BSTR(BSTR_OP_OR, false);
             break;
 
          case ANDBSU:
-            DO_BSTR(BSTR_OP_AND);
+            DO_BSTR(BSTR_OP_AND, false);
             break;
 
          case XORBSU:
-            DO_BSTR(BSTR_OP_XOR);
+            DO_BSTR(BSTR_OP_XOR, false);
             break;
 
          case MOVBSU:
-            DO_BSTR(BSTR_OP_MOV);
+            DO_BSTR(BSTR_OP_MOV, true);
             break;
 
          case ORNBSU:
-            DO_BSTR(BSTR_OP_ORN);
+            DO_BSTR(BSTR_OP_ORN, false);
             break;
 
          case ANDNBSU:
-            DO_BSTR(BSTR_OP_ANDN);
+            DO_BSTR(BSTR_OP_ANDN, false);
             break;
 
          case XORNBSU:
-            DO_BSTR(BSTR_OP_XORN);
+            DO_BSTR(BSTR_OP_XORN, false);
             break;
 
          case NOTBSU:
-            DO_BSTR(BSTR_OP_NOT);
+            DO_BSTR(BSTR_OP_NOT, false);
             break;
       }
 
@@ -855,16 +1307,16 @@ INLINE bool V810::CheckFPInputException(uint32 fpval)
 
 bool V810::FPU_DoesExceptionKillResult(void)
 {
-   if(float_exception_flags & float_flag_invalid)
+   if(FPUStatus.float_exception_flags & float_flag_invalid)
       return true;
-   if(float_exception_flags & float_flag_divbyzero)
+   if(FPUStatus.float_exception_flags & float_flag_divbyzero)
       return true;
    return false;
 }
 
 void V810::FPU_DoException(void)
 {
-   if(float_exception_flags & float_flag_invalid)
+   if(FPUStatus.float_exception_flags & float_flag_invalid)
    {
       S_REG[PSW] |= PSW_FIV;
 
@@ -874,7 +1326,7 @@ void V810::FPU_DoException(void)
       return;
    }
 
-   if(float_exception_flags & float_flag_divbyzero)
+   if(FPUStatus.float_exception_flags & float_flag_divbyzero)
    {
       S_REG[PSW] |= PSW_FZD;
 
@@ -884,15 +1336,15 @@ void V810::FPU_DoException(void)
       return;
    }
 
-   if(float_exception_flags & float_flag_underflow)
+   if(FPUStatus.float_exception_flags & float_flag_underflow)
       S_REG[PSW] |= PSW_FUD;
 
-   if(float_exception_flags & float_flag_inexact)
+   if(FPUStatus.float_exception_flags & float_flag_inexact)
       S_REG[PSW] |= PSW_FPR;
 
    /* FPR can be set along with overflow, so put the overflow exception handling
  * at the end here(for Exception() messes with PSW). */
-   if(float_exception_flags & float_flag_overflow)
+   if(FPUStatus.float_exception_flags & float_flag_overflow)
    {
       S_REG[PSW] |= PSW_FOV;
 
@@ -908,27 +1360,174 @@ bool V810::IsSubnormal(uint32 fpval)
    return false;
 }
 
-INLINE void V810::FPU_Math_Template(float32 (*func)(float32, float32), uint32 arg1, uint32 arg2)
+/*
+ * Host FPU fast path.  The helpers below are only called with zero or normal inputs(anything else
+ * raises the reserved operand exception first), and return false when the result needs SoftFloat's
+ * exact flag handling: overflow, a result that is or may round to a subnormal, division by zero
+ * and out-of-range conversions.  Otherwise the result is bit-identical to SoftFloat's, and
+ * *inexact tells whether PSW.FPR must be set.
+ *
+ * Disabled where the host evaluates float expressions in extended precision(x87) or when
+ * compiled with -ffast-math, since then host results can't be trusted to be exact.
+ */
+#if !defined(__FAST_MATH__) && defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define V810_HOST_FPU
+#endif
+
+#ifdef V810_HOST_FPU
+#define FPU_HOST_FUNC(f) f
+
+static INLINE float FPU_HostFloat(uint32 v)
+{
+   float f;
+
+   memcpy(&f, &v, sizeof(f));
+   return f;
+}
+
+static INLINE uint32 FPU_HostBits(float f)
+{
+   uint32 v;
+
+   memcpy(&v, &f, sizeof(v));
+   return v;
+}
+
+/* exact must be the exact result of the operation. */
+static INLINE bool FPU_HostRound(double exact, uint32 *result, bool *inexact)
+{
+   const float r = (float)exact;
+
+   if(exact != 0 && !(fabs(r) > FLT_MIN && fabs(r) <= FLT_MAX))
+      return false;
+
+   *result = FPU_HostBits(r);
+   *inexact = ((double)r != exact);
+   return true;
+}
+
+/* A sum of two floats is exact as a double unless their exponents are more than 28 apart. */
+static INLINE bool FPU_HostSumIsExact(uint32 a, uint32 b)
+{
+   const int ea = (a >> 23) & 0xFF;
+   const int eb = (b >> 23) & 0xFF;
+
+   return !ea || !eb || abs(ea - eb) <= 28;
+}
+
+static bool FPU_Host_Add(uint32 a, uint32 b, uint32 *result, bool *inexact)
+{
+   if(!FPU_HostSumIsExact(a, b))
+      return false;
+
+   return FPU_HostRound((double)FPU_HostFloat(a) + (double)FPU_HostFloat(b), result, inexact);
+}
+
+static bool FPU_Host_Sub(uint32 a, uint32 b, uint32 *result, bool *inexact)
+{
+   if(!FPU_HostSumIsExact(a, b))
+      return false;
+
+   return FPU_HostRound((double)FPU_HostFloat(a) - (double)FPU_HostFloat(b), result, inexact);
+}
+
+static bool FPU_Host_Mul(uint32 a, uint32 b, uint32 *result, bool *inexact)
+{
+   /* 24x24-bit product, always exact as a double */
+   return FPU_HostRound((double)FPU_HostFloat(a) * (double)FPU_HostFloat(b), result, inexact);
+}
+
+static bool FPU_Host_Div(uint32 a, uint32 b, uint32 *result, bool *inexact)
+{
+   const double fa = FPU_HostFloat(a);
+   const double fb = FPU_HostFloat(b);
+   float r;
+
+   if(!(b & 0x7FFFFFFF))
+      return false;
+
+   /* Rounding the double quotient again to single precision still gives the correctly
+    * rounded quotient(53 >= 2 * 24 + 2). */
+   r = (float)(fa / fb);
+
+   if(fa != 0 && !(fabs(r) > FLT_MIN && fabs(r) <= FLT_MAX))
+      return false;
+
+   *result = FPU_HostBits(r);
+   *inexact = ((double)r * fb != fa);
+   return true;
+}
+
+/* Round to nearest even(round_to_zero false) or toward zero, like float32_to_int32() and
+ * float32_to_int32_round_to_zero(). */
+static INLINE bool FPU_Host_ToInt(uint32 a, bool round_to_zero, int32 *result, bool *inexact)
+{
+   const float f = FPU_HostFloat(a);
+   int32 z;
+   double frac;
+
+   if(!(f >= -2147483648.0f && f < 2147483648.0f))
+      return false;
+
+   z = (int32)f;
+   frac = (double)f - z;
+
+   if(!round_to_zero)
+   {
+      if(frac > 0.5 || (frac == 0.5 && (z & 1)))
+         z++;
+      else if(frac < -0.5 || (frac == -0.5 && (z & 1)))
+         z--;
+   }
+
+   *result = z;
+   *inexact = (frac != 0);
+   return true;
+}
+#else
+#define FPU_HOST_FUNC(f) NULL
+#endif
+
+INLINE void V810::FPU_Math_Template(float32 (*func)(float32, float32, float_status *), bool (*host_func)(uint32, uint32, uint32 *, bool *), uint32 arg1, uint32 arg2)
 {
    if(CheckFPInputException(P_REG[arg1]) || CheckFPInputException(P_REG[arg2]))
       return;
+
+#ifdef V810_HOST_FPU
+   if(FPUHostMath)
+   {
+      uint32 result;
+      bool inexact;
+
+      if(host_func(P_REG[arg1], P_REG[arg2], &result, &inexact))
+      {
+         SetFPUOPNonFPUFlags(result);
+         SetPREG(arg1, result);
+
+         if(inexact)
+            S_REG[PSW] |= PSW_FPR;
+         return;
+      }
+   }
+#endif
+
    {
       uint32 result;
 
-      float_exception_flags = 0;
-      result = func(P_REG[arg1], P_REG[arg2]);
+      FPUStatus.float_exception_flags = 0;
+      result = func(P_REG[arg1], P_REG[arg2], &FPUStatus);
 
       if(IsSubnormal(result))
       {
-         float_exception_flags |= float_flag_underflow;
-         float_exception_flags |= float_flag_inexact;
+         FPUStatus.float_exception_flags |= float_flag_underflow;
+         FPUStatus.float_exception_flags |= float_flag_inexact;
       }
 
       if(!FPU_DoesExceptionKillResult())
       {
          /* Force it to +/- zero before setting S/Z based off of it(confirmed
           * with subf.s on real V810, at least). */
-         if(float_exception_flags & float_flag_underflow)
+         if(FPUStatus.float_exception_flags & float_flag_underflow)
             result &= 0x80000000;
 
          SetFPUOPNonFPUFlags(result);
@@ -991,11 +1590,25 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
 
       case CVT_WS: 
          timestamp += 5;
+#ifdef V810_HOST_FPU
+         if(FPUHostMath)
+         {
+            const float r = (float)(int32)P_REG[arg2];
+            const uint32 result = FPU_HostBits(r);
+
+            SetPREG(arg1, result);
+            SetFPUOPNonFPUFlags(result);
+
+            if((double)r != (double)(int32)P_REG[arg2])
+               S_REG[PSW] |= PSW_FPR;
+            break;
+         }
+#endif
          {
             uint32 result;
 
-            float_exception_flags = 0;
-            result = int32_to_float32((int32)P_REG[arg2]);
+            FPUStatus.float_exception_flags = 0;
+            result = int32_to_float32((int32)P_REG[arg2], &FPUStatus);
 
             if(!FPU_DoesExceptionKillResult())
             {
@@ -1012,9 +1625,23 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
          else
          {
             int32 result;
+#ifdef V810_HOST_FPU
+            bool inexact;
+
+            if(FPUHostMath && FPU_Host_ToInt(P_REG[arg2], false, &result, &inexact))
+            {
+               SetPREG(arg1, result);
+               SetFlag(PSW_OV, 0);
+               SetSZ(result);
+
+               if(inexact)
+                  S_REG[PSW] |= PSW_FPR;
+               break;
+            }
+#endif
 
-            float_exception_flags = 0;
-            result = float32_to_int32(P_REG[arg2]);
+            FPUStatus.float_exception_flags = 0;
+            result = float32_to_int32(P_REG[arg2], &FPUStatus);
 
             if(!FPU_DoesExceptionKillResult())
             {
@@ -1028,11 +1655,11 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
 
       case ADDF_S:
          timestamp += 8;
-         FPU_Math_Template(float32_add, arg1, arg2);
+         FPU_Math_Template(float32_add, FPU_HOST_FUNC(FPU_Host_Add), arg1, arg2);
          break;
       case SUBF_S:
          timestamp += 11;
-         FPU_Math_Template(float32_sub, arg1, arg2);
+         FPU_Math_Template(float32_sub, FPU_HOST_FUNC(FPU_Host_Sub), arg1, arg2);
          break;
       case CMPF_S:
          timestamp += 6;
@@ -1045,9 +1672,24 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
          }
          else
          {
+            bool eq, lt;
+
+#ifdef V810_HOST_FPU
+            if(FPUHostMath)
+            {
+               eq = FPU_HostFloat(P_REG[arg1]) == FPU_HostFloat(P_REG[arg2]);
+               lt = FPU_HostFloat(P_REG[arg1]) < FPU_HostFloat(P_REG[arg2]);
+            }
+            else
+#endif
+            {
+               eq = float32_eq(P_REG[arg1], P_REG[arg2], &FPUStatus);
+               lt = float32_lt(P_REG[arg1], P_REG[arg2], &FPUStatus);
+            }
+
             SetFlag(PSW_OV, 0);
 
-            if(float32_eq(P_REG[arg1], P_REG[arg2]))
+            if(eq)
             {
                SetFlag(PSW_Z, 1);
                SetFlag(PSW_S, 0);
@@ -1057,7 +1699,7 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
             {
                SetFlag(PSW_Z, 0);
 
-               if(float32_lt(P_REG[arg1], P_REG[arg2]))
+               if(lt)
                {
                   SetFlag(PSW_S, 1);
                   SetFlag(PSW_CY, 1);
@@ -1073,12 +1715,12 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
 
       case MULF_S:
          timestamp += 7;
-         FPU_Math_Template(float32_mul, arg1, arg2);
+         FPU_Math_Template(float32_mul, FPU_HOST_FUNC(FPU_Host_Mul), arg1, arg2);
          break;
 
       case DIVF_S:
          timestamp += 43;
-         FPU_Math_Template(float32_div, arg1, arg2);
+         FPU_Math_Template(float32_div, FPU_HOST_FUNC(FPU_Host_Div), arg1, arg2);
          break;
 
       case TRNC_SW:
@@ -1091,9 +1733,23 @@ void V810::fpu_subop(v810_timestamp_t &timestamp, int sub_op, int arg1, int arg2
          else
          {
             int32 result;
+#ifdef V810_HOST_FPU
+            bool inexact;
+
+            if(FPUHostMath && FPU_Host_ToInt(P_REG[arg2], true, &result, &inexact))
+            {
+               SetPREG(arg1, result);
+               SetFlag(PSW_OV, 0);
+               SetSZ(result);
+
+               if(inexact)
+                  S_REG[PSW] |= PSW_FPR;
+               break;
+            }
+#endif
 
-            float_exception_flags = 0;
-            result = float32_to_int32_round_to_zero(P_REG[arg2]);
+            FPUStatus.float_exception_flags = 0;
+            result = float32_to_int32_round_to_zero(P_REG[arg2], &FPUStatus);
 
             if(!FPU_DoesExceptionKillResult())
             {
@@ -1246,6 +1902,11 @@ int V810::StateAction(StateMem *sm, int load, int data_only)
       RecalcIPendingCache();
 
       SetPC(PC_tmp);
+
+      /* Memory was replaced behind our back. */
+      if(JIT)
+         JIT_Flush();
+
       if(EmuMode == V810_EMU_MODE_ACCURATE)
       {
          int i;
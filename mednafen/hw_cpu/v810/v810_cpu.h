@@ -7,11 +7,21 @@
 
 #include "fpu-new/softfloat.h"
 #include "../../mednafen-types.h"
+#include "../../masmem.h"
 #include "../../state.h"
 
 #define V810_FAST_MAP_SHIFT	16
 #define V810_FAST_MAP_PSIZE     (1 << V810_FAST_MAP_SHIFT)
+#define V810_FAST_MAP_ADDR_MASK	((1U << 27) - 1)	/* Only 27 address bits are decoded; the rest is mirrors */
 #define V810_FAST_MAP_TRAMPOLINE_SIZE	1024
+#define V810_FAST_MAP_MAX_REGIONS	8
+#define V810_DATA_MAP_MAX_REGIONS	(V810_FAST_MAP_MAX_REGIONS + 4)	/* FastMap regions are in the data map too */
+
+#define V810_IDLE_LOOP_MAX_SIZE		64	/* Bytes, including the closing branch */
+#define V810_IDLE_LOOP_CACHE_SIZE	64	/* Entries; power of 2 */
+#define V810_JIT_NO_CODE_SIZE		4096	/* Entries; power of 2 */
+#define V810_JIT_GRANULE_SHIFT		10	/* Recompiled code is tracked, and discarded on stores, per (1 << this) bytes */
+#define V810_JIT_CODE_MAP_SIZE		4096	/* Entries; power of 2 */
 
 /* Exception codes */
 enum
@@ -140,12 +150,33 @@ typedef enum
 {
    V810_EMU_MODE_FAST     = 0,
    V810_EMU_MODE_ACCURATE = 1,
+   V810_EMU_MODE_JIT      = 2, /* FAST timing, hot blocks recompiled to host code(x86-64 only); events are checked per block */
    _V810_EMU_MODE_COUNT
 } V810_Emu_Mode;
 
+struct V810_JIT;
+struct V810_JITBlock;
+
+/* Idle loop scan result, keyed by the guest address of the closing backward branch */
+typedef struct
+{
+   uint32 branch_pc;		/* 0 when unused; cartridge ROM addresses are never 0 */
+   bool idle;
+} V810_IdleLoopEntry;
+
+/* Memory that loads and stores can access directly(see V810::SetDataMap()) */
+typedef struct
+{
+   uint8 *data;
+   uint8 *dirty;		/* Flags set by stores, one per (1 << dirty_shift) bytes; NULL if not tracked */
+   unsigned int dirty_shift;
+   bool writable;
+   bool code;			/* Mapped with SetFastMap(), so stores go through InvalidateCode() */
+} V810_DataMapRegion;
+
 /*
- * WARNING: Do NOT instantiate this class in multiple threads in such a way that both threads can be inside a method of this class at the same time.
- * To fix this, you'll need to put locks or something(re-engineer it to use state passed in through pointers) around the SoftFloat code.
+ * Each instance keeps its own SoftFloat state(FPUStatus), so separate instances can be run on separate threads.
+ * A single instance must still only be used by one thread at a time.
  */
 
 
@@ -167,6 +198,11 @@ class V810
  void SetMemWriteBus32(uint8 A, bool value);
  void SetMemReadBus32(uint8 A, bool value);
 
+ /* For a region on the 16-bit bus, lets the 32-bit handler do both halves of a 32-bit access in one
+  * call.  Timing is still that of two 16-bit accesses, so the handler mustn't depend on it. */
+ void SetMemWriteWord32(uint8 A, bool value);
+ void SetMemReadWord32(uint8 A, bool value);
+
  void SetMemReadHandlers(uint8 MDFN_FASTCALL (*read8)(v810_timestamp_t &, uint32), uint16 MDFN_FASTCALL (*read16)(v810_timestamp_t &, uint32), uint32 MDFN_FASTCALL (*read32)(v810_timestamp_t &, uint32));
  void SetMemWriteHandlers(void MDFN_FASTCALL (*write8)(v810_timestamp_t &, uint32, uint8), void MDFN_FASTCALL (*write16)(v810_timestamp_t &, uint32, uint16), void MDFN_FASTCALL (*write32)(v810_timestamp_t &, uint32, uint32));
 
@@ -175,8 +211,17 @@ class V810
 
  /* Length specifies the number of bytes to map in, 
   * at each location specified
-  * by addresses[] (for mirroring) */
- uint8 *SetFastMap(uint32 addresses[], uint32 length, unsigned int num_addresses, const char *name);
+  * by addresses[] (for mirroring).
+  * The memory handlers must access FastMap memory without wait states; writable specifies whether
+  * they store to it(true for RAM, false for ROM). */
+ uint8 *SetFastMap(uint32 addresses[], uint32 length, unsigned int num_addresses, const char *name, bool writable);
+
+ /* Maps memory owned by the caller in for loads and stores, but not instruction fetches, at each location
+  * in addresses[]; length must be a multiple of V810_FAST_MAP_PSIZE.  As with SetFastMap(), the memory
+  * handlers must access it without side effects or wait states.  If dirty isn't NULL, each store through
+  * the map sets dirty[offset >> dirty_shift](dirty_shift >= 2) to 1; only the caller clears them.
+  * Returns false if there are too many regions. */
+ bool SetDataMap(uint32 addresses[], uint32 length, unsigned int num_addresses, uint8 *data, bool writable, uint8 *dirty, unsigned int dirty_shift);
 
  INLINE void ResetTS(v810_timestamp_t new_base_timestamp)
  {
@@ -209,6 +254,22 @@ class V810
 
  uint32 GetSR(const unsigned int which);
 
+ /* When enabled, a short side-effect-free polling loop in cartridge ROM is fast-forwarded
+  * to the next event, like HALT is.  Not used in accurate mode. */
+ void SetIdleLoopSkip(bool enable);
+
+ /* When enabled, floating-point instructions use the host FPU, falling back to SoftFloat
+  * for results that need exact exception flag emulation.  Results are the same either way. */
+ void SetFPUHostMath(bool enable);
+
+ /* Must be called by the write handlers after any write to memory mapped in with SetFastMap(),
+  * so that recompiled code covering the written location is discarded. */
+ INLINE void InvalidateCode(const uint8 *ptr)
+ {
+  if(JIT && JITCodeMap[((uintptr_t)ptr >> V810_JIT_GRANULE_SHIFT) & (V810_JIT_CODE_MAP_SIZE - 1)])
+   JIT_Invalidate(ptr);
+ }
+
  private:
 
  /* Make sure P_REG[] is the first variable/array in this class, 
@@ -245,6 +306,7 @@ class V810
 
  void Run_Fast(int32 MDFN_FASTCALL (*event_handler)(const v810_timestamp_t timestamp)) NO_INLINE;
  void Run_Accurate(int32 MDFN_FASTCALL (*event_handler)(const v810_timestamp_t timestamp)) NO_INLINE;
+ void Run_JIT(int32 MDFN_FASTCALL (*event_handler)(const v810_timestamp_t timestamp)) NO_INLINE;
 
  uint8 MDFN_FASTCALL (*MemRead8)(v810_timestamp_t &timestamp, uint32 A);
  uint16 MDFN_FASTCALL (*MemRead16)(v810_timestamp_t &timestamp, uint32 A);
@@ -266,6 +328,29 @@ class V810
                                  of the memory address map. */
  bool MemWriteBus32[256];
 
+ bool MemReadWord32[256];
+ bool MemWriteWord32[256];
+
+ /* 32-bit access over the 16-bit bus */
+ INLINE uint32 MemReadWord(v810_timestamp_t &timestamp, uint32 A)
+ {
+  if(MemReadWord32[A >> 24])
+   return MemRead32(timestamp, A);
+
+  return MemRead16(timestamp, A) | (MemRead16(timestamp, A | 2) << 16);
+ }
+
+ INLINE void MemWriteWord(v810_timestamp_t &timestamp, uint32 A, uint32 V)
+ {
+  if(MemWriteWord32[A >> 24])
+   MemWrite32(timestamp, A, V);
+  else
+  {
+   MemWrite16(timestamp, A, V & 0xFFFF);
+   MemWrite16(timestamp, A | 2, V >> 16);
+  }
+ }
+
  int32 lastop;    /* Set to -1 on FP/MUL/DIV, 0x100 on LD, 0x200 on ST, 
                      0x400 on in,
                      0x800 on out, and the actual 
@@ -312,8 +397,124 @@ class V810
  uint32 dst_cache;
  bool have_src_cache, have_dst_cache;
 
- uint8 *FastMap[(1ULL << 32) / V810_FAST_MAP_PSIZE];
- uint8 *FastMapAllocList;
+ /* Host address of each page(DummyRegion if it's unmapped), for addresses masked with V810_FAST_MAP_ADDR_MASK. */
+ uint8 *FastMap[(V810_FAST_MAP_ADDR_MASK + 1) / V810_FAST_MAP_PSIZE];
+
+ INLINE uint8 *FastMapPtr(uint32 A)
+ {
+  return FastMap[(A & V810_FAST_MAP_ADDR_MASK) >> V810_FAST_MAP_SHIFT] + (A & (V810_FAST_MAP_PSIZE - 1));
+ }
+
+ struct
+ {
+    uint8 *data;
+    uint32 length;
+    bool writable;
+ } FastMapRegions[V810_FAST_MAP_MAX_REGIONS];
+ unsigned int FastMapRegionCount;
+
+ /* Host address of each page for loads and stores(NULL if the memory handlers have to do them), and
+  * its DataMapRegions[] entry(0, which isn't writable, if none). */
+ uint8 *DataMap[(V810_FAST_MAP_ADDR_MASK + 1) / V810_FAST_MAP_PSIZE];
+ uint8 DataMapIndex[(V810_FAST_MAP_ADDR_MASK + 1) / V810_FAST_MAP_PSIZE];
+ V810_DataMapRegion DataMapRegions[1 + V810_DATA_MAP_MAX_REGIONS];
+ unsigned int DataMapRegionCount;
+
+ bool AddDataMapRegion(uint32 addresses[], uint32 length, unsigned int num_addresses, uint8 *data, bool writable, bool code, uint8 *dirty, unsigned int dirty_shift);
+ void ClearDataMap(void);
+
+ INLINE uint8 *DataLoadPtr(uint32 A)
+ {
+  uint8 *page = DataMap[(A & V810_FAST_MAP_ADDR_MASK) >> V810_FAST_MAP_SHIFT];
+
+  return page ? page + (A & (V810_FAST_MAP_PSIZE - 1)) : NULL;
+ }
+
+ /* For a store of size(1, 2 or 4) bytes to A, which must be aligned; takes care of InvalidateCode()
+  * and the dirty flags, so the caller only has to do the store itself.  NULL if the memory handlers have to. */
+ INLINE uint8 *DataStorePtr(uint32 A, unsigned int size)
+ {
+  const uint32 page = (A & V810_FAST_MAP_ADDR_MASK) >> V810_FAST_MAP_SHIFT;
+  const V810_DataMapRegion *r = &DataMapRegions[DataMapIndex[page]];
+  uint8 *ptr;
+
+  if(!r->writable)
+   return NULL;
+
+  ptr = DataMap[page] + (A & (V810_FAST_MAP_PSIZE - 1));
+
+  if(r->code)
+  {
+   InvalidateCode(ptr);
+   if(size == 4)
+    InvalidateCode(ptr + 2);
+  }
+
+  if(r->dirty)
+   r->dirty[(ptr - r->data) >> r->dirty_shift] = 1;
+
+  return ptr;
+ }
+
+ /* Loads and stores done by instructions; timing is left to the caller. */
+ INLINE uint8 DataLoad8(v810_timestamp_t &timestamp, uint32 A)
+ {
+  const uint8 *ptr = DataLoadPtr(A);
+
+  return ptr ? *ptr : MemRead8(timestamp, A);
+ }
+
+ INLINE uint16 DataLoad16(v810_timestamp_t &timestamp, uint32 A)
+ {
+  const uint8 *ptr = DataLoadPtr(A);
+
+  return ptr ? LoadU16_LE((const uint16 *)ptr) : MemRead16(timestamp, A);
+ }
+
+ INLINE uint32 DataLoad32(v810_timestamp_t &timestamp, uint32 A)
+ {
+  const uint8 *ptr = DataLoadPtr(A);
+
+  if(ptr)
+   return LoadU32_LE((const uint32 *)ptr);
+
+  if(MemReadBus32[A >> 24])
+   return MemRead32(timestamp, A);
+
+  return MemReadWord(timestamp, A);
+ }
+
+ INLINE void DataStore8(v810_timestamp_t &timestamp, uint32 A, uint8 V)
+ {
+  uint8 *ptr = DataStorePtr(A, 1);
+
+  if(ptr)
+   *ptr = V;
+  else
+   MemWrite8(timestamp, A, V);
+ }
+
+ INLINE void DataStore16(v810_timestamp_t &timestamp, uint32 A, uint16 V)
+ {
+  uint8 *ptr = DataStorePtr(A, 2);
+
+  if(ptr)
+   StoreU16_LE((uint16 *)ptr, V);
+  else
+   MemWrite16(timestamp, A, V);
+ }
+
+ INLINE void DataStore32(v810_timestamp_t &timestamp, uint32 A, uint32 V)
+ {
+  uint8 *ptr = DataStorePtr(A, 4);
+
+  if(ptr)
+   StoreU32_LE((uint32 *)ptr, V);
+  else if(MemWriteBus32[A >> 24])
+   MemWrite32(timestamp, A, V);
+  else
+   MemWriteWord(timestamp, A, V);
+ }
 
  /* For CacheDump and CacheRestore */
  void CacheOpMemStore(v810_timestamp_t &timestamp, uint32 A, uint32 V);
@@ -338,7 +539,7 @@ class V810
 
 
  bool IsSubnormal(uint32 fpval);
- void FPU_Math_Template(float32 (*func)(float32, float32), uint32 arg1, uint32 arg2);
+ void FPU_Math_Template(float32 (*func)(float32, float32, float_status *), bool (*host_func)(uint32, uint32, uint32 *, bool *), uint32 arg1, uint32 arg2);
  void FPU_DoException(void);
  bool CheckFPInputException(uint32 fpval);
  bool FPU_DoesExceptionKillResult(void);
@@ -347,10 +548,62 @@ class V810
 
  uint32 BSTR_RWORD(v810_timestamp_t &timestamp, uint32 A);
  void BSTR_WWORD(v810_timestamp_t &timestamp, uint32 A, uint32 V);
+ bool BSTR_MoveWords(v810_timestamp_t &timestamp, uint32 &src, uint32 &dst, uint32 &len);
  bool Do_BSTR_Search(v810_timestamp_t &timestamp, const int inc_mul, unsigned int bit_test);
 
 
- uint8 DummyRegion[V810_FAST_MAP_PSIZE + V810_FAST_MAP_TRAMPOLINE_SIZE];
+ float_status FPUStatus;	/* SoftFloat exception flags */
+ bool FPUHostMath;
+
+ /* Idle loop detection */
+ bool IdleLoopSkip;
+ V810_IdleLoopEntry IdleLoopCache[V810_IDLE_LOOP_CACHE_SIZE];
+
+ bool IdleLoop_Scan(uint32 loop_pc, uint32 branch_pc);
+
+ /* loop_pc is the target of the taken backward branch at branch_pc. */
+ INLINE bool IsIdleLoop(uint32 loop_pc, uint32 branch_pc)
+ {
+  V810_IdleLoopEntry *ent = &IdleLoopCache[(branch_pc >> 1) & (V810_IDLE_LOOP_CACHE_SIZE - 1)];
+
+  if(MDFN_UNLIKELY(ent->branch_pc != branch_pc))
+  {
+   ent->branch_pc = branch_pc;
+   ent->idle = IdleLoop_Scan(loop_pc, branch_pc);
+  }
+
+  return ent->idle;
+ }
+
+ /* Dynamic recompiler(v810_jit.cpp) */
+ V810_JIT *JIT;
+ v810_timestamp_t JITTimestamp;	/* Timestamp while inside a helper called from recompiled code. */
+ bool JITStop;			/* Set when the block being executed has been invalidated. */
+ int32 JITLink;			/* Chainable exit the last block left through, or -1. */
+ const uint8 *JITNoCode[V810_JIT_NO_CODE_SIZE];	/* PC_ptrs recently found to have no recompiled code */
+ uint32 JITCodeMap[V810_JIT_CODE_MAP_SIZE];	/* Per (hashed) granule-sized host page, granules with blocks overlapping it */
+
+ INLINE bool JIT_HasNoCode(void)
+ {
+  return JITNoCode[((uintptr_t)PC_ptr >> 1) & (V810_JIT_NO_CODE_SIZE - 1)] == PC_ptr;
+ }
+
+ bool JIT_Init(void);
+ void JIT_Kill(void);
+ void JIT_Flush(void);
+ void JIT_Invalidate(const uint8 *ptr);
+ void JIT_CountGranule(unsigned int r, uint32 g, int32 delta);
+ bool JIT_Exec(v810_timestamp_t &timestamp);
+ V810_JITBlock *JIT_Compile(void);
+
+ static uint32 JIT_LD_B(V810 *cpu, uint32 A, uint32 reg);
+ static uint32 JIT_LD_H(V810 *cpu, uint32 A, uint32 reg);
+ static uint32 JIT_LD_W(V810 *cpu, uint32 A, uint32 reg);
+ static uint32 JIT_ST_B(V810 *cpu, uint32 A, uint32 V);
+ static uint32 JIT_ST_H(V810 *cpu, uint32 A, uint32 V);
+ static uint32 JIT_ST_W(V810 *cpu, uint32 A, uint32 V);
+
+ uint8 *DummyRegion;	/* Shared by all instances */
 };
 
 #endif
@@ -0,0 +1,1626 @@
+/* Mednafen - Multi-system Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * V810 dynamic recompiler(x86-64, System V ABI).
+ *
+ * Basic blocks starting in FastMap regions are translated to host code the first time they're
+ * reached, and run from the RB_CPUHOOK() point of Run_JIT() instead of the interpreter.
+ * Instructions take the same cycles as in Run_Fast(), but events are serviced later:
+ *
+ *  - The timestamp is compared against next_event_ts only when a block is entered(including a branch
+ *    back to its own start), and a block, at most JIT_MAX_INSNS instructions, then runs to its end.
+ *    Run_Fast() checks before every instruction, so an event(and the interrupt it raises) can be
+ *    serviced up to one block later, with the timestamp that much further past it.  A store that
+ *    raises an interrupt or rewrites recompiled code still leaves the block right after it.
+ *  - Cycles are added to the timestamp in one go wherever it's looked at: before calling a helper,
+ *    and when leaving the block.  Helpers(and so memory handlers) see the same timestamp as in
+ *    Run_Fast().
+ *  - Loads from memory in the data map(see V810::SetDataMap()) are done inline; anything else, and
+ *    all stores, go through helpers that mirror the interpreter's LD/ST code.
+ *  - Bit string, FPU, I/O, system register writes, interrupt enable/disable, traps and the like end
+ *    the block, and are left to the interpreter.
+ *
+ * Blocks never cross a 1KiB granule of their FastMap region; writes reported through
+ * InvalidateCode() discard every block in the written granule.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "../../masmem.h"
+#include "../../math_ops.h"
+
+#include "v810_opt.h"
+#include "v810_cpu.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define V810_JIT_X86_64
+#endif
+
+#ifdef V810_JIT_X86_64
+
+#include <sys/mman.h>
+#include <cpuid.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+enum
+{
+   JIT_BUFFER_SIZE     = 8 * 1024 * 1024,
+   JIT_BUFFER_SLACK    = 64 * 1024,	/* Flush when less than this is left before compiling. */
+   JIT_BLOCK_SLACK     = 4096,		/* End the block being emitted when less than this is left. */
+   JIT_MAX_BLOCKS      = 32768,
+   JIT_MAX_LINKS       = 65536,
+   JIT_HASH_SIZE       = 16384,
+   JIT_JUMP_CACHE_SIZE = 1024,		/* Power of 2 */
+   JIT_MAX_INSNS       = 32,
+   JIT_MIN_INSNS       = 4,		/* Shorter runs up to an instruction that can't be recompiled are left to the interpreter. */
+   JIT_GRANULE_SHIFT   = V810_JIT_GRANULE_SHIFT,
+   JIT_SMC_LIMIT       = 16		/* Code invalidations after which a granule is only interpreted, until the next flush. */
+};
+
+struct V810_JITBlock
+{
+   uint8 *pc_ptr;
+   uint8 *pc_base;
+   uint8 *code;		/* NULL if the code here is left to the interpreter. */
+   int32 hash_next;
+   int32 gran_next;
+   int32 in_links;	/* Exits of other blocks jumping straight here */
+};
+
+/* A block exit to a fixed guest address, which can be patched to jump straight to the block there. */
+struct V810_JITLink
+{
+   uint8 *rel;		/* rel32 of the jump */
+   uint8 *stub;		/* Where it jumps while unlinked */
+   uint8 *pc_ptr;
+   uint8 *pc_base;
+   int32 next;		/* Next link into the same block */
+   bool linked;
+};
+
+/* Where indirect jumps look up the block to continue at, from recompiled code(see EmitJumpLookup()) */
+struct V810_JITJump
+{
+   uint8 *pc_ptr;	/* NULL if unused */
+   uint8 *pc_base;
+   uint8 *code;
+};
+
+struct V810_JITGranule
+{
+   int32 head;		/* Blocks starting in this granule */
+   uint32 smc_count;
+};
+
+struct V810_JIT
+{
+   uint8 *buffer;
+   uint8 *code_start;
+   uint8 *ptr;
+   uint8 *epilogue;
+   int32 (*enter)(V810 *cpu, int32 timestamp, uint8 *code);
+
+   V810_JITBlock blocks[JIT_MAX_BLOCKS];
+   uint32 block_count;
+   int32 free_head;	/* Discarded blocks, linked through hash_next */
+   V810_JITLink links[JIT_MAX_LINKS];
+   uint32 link_count;
+   int32 hash_head[JIT_HASH_SIZE];
+   V810_JITJump jump_cache[JIT_JUMP_CACHE_SIZE];	/* Blocks with code, direct-mapped by JIT_JumpHash() */
+   V810_JITGranule *granules[V810_FAST_MAP_MAX_REGIONS];
+
+   uint8 flag_lut[256];	/* LAHF result -> PSW Z/S/CY */
+};
+
+/*
+ * x86-64 emitter
+ */
+enum { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum { CC_O = 0, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A, CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G };
+enum { ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7 };
+enum { SH_SHL = 4, SH_SHR = 5, SH_SAR = 7 };
+
+static INLINE void Put8(uint8 *&p, uint8 v)
+{
+   *p++ = v;
+}
+
+static INLINE void Put32(uint8 *&p, uint32 v)
+{
+   memcpy(p, &v, 4);
+   p += 4;
+}
+
+static INLINE void Put64(uint8 *&p, uint64 v)
+{
+   memcpy(p, &v, 8);
+   p += 8;
+}
+
+static void Rex(uint8 *&p, bool w, unsigned reg, unsigned index, unsigned base, bool force)
+{
+   const uint8 rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+
+   if(rex != 0x40 || force)
+      Put8(p, rex);
+}
+
+static void Opcode(uint8 *&p, uint32 opc)
+{
+   if(opc > 0xFF)
+      Put8(p, opc >> 8);
+   Put8(p, opc);
+}
+
+/* opc reg, [base + index * scale + disp]; index < 0 for none. */
+static void InsM(uint8 *&p, bool w, uint32 opc, unsigned reg, unsigned base, int index, unsigned scale, int32 disp)
+{
+   unsigned mod;
+
+   Rex(p, w, reg, (index < 0) ? 0 : index, base, false);
+   Opcode(p, opc);
+
+   if(disp == 0 && (base & 7) != RBP)
+      mod = 0;
+   else if(disp >= -128 && disp < 128)
+      mod = 1;
+   else
+      mod = 2;
+
+   if(index >= 0 || (base & 7) == RSP)
+   {
+      const unsigned ss = (scale == 8) ? 3 : (scale == 4) ? 2 : (scale == 2) ? 1 : 0;
+
+      Put8(p, (mod << 6) | ((reg & 7) << 3) | 4);
+      Put8(p, (ss << 6) | ((((index < 0) ? RSP : index) & 7) << 3) | (base & 7));
+   }
+   else
+      Put8(p, (mod << 6) | ((reg & 7) << 3) | (base & 7));
+
+   if(mod == 1)
+      Put8(p, disp);
+   else if(mod == 2)
+      Put32(p, disp);
+}
+
+/* opc reg, rm(register direct); byte_reg for 8-bit operands. */
+static void InsR(uint8 *&p, bool w, uint32 opc, unsigned reg, unsigned rm, bool byte_reg = false)
+{
+   Rex(p, w, reg, 0, rm, byte_reg && ((reg & 0xC) == 4 || (rm & 0xC) == 4));
+   Opcode(p, opc);
+   Put8(p, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void MovRI(uint8 *&p, unsigned dst, uint32 imm)
+{
+   Rex(p, false, 0, 0, dst, false);
+   Put8(p, 0xB8 | (dst & 7));
+   Put32(p, imm);
+}
+
+static void MovRI64(uint8 *&p, unsigned dst, uint64 imm)
+{
+   Rex(p, true, 0, 0, dst, false);
+   Put8(p, 0xB8 | (dst & 7));
+   Put64(p, imm);
+}
+
+static void AluRI(uint8 *&p, bool w, unsigned op, unsigned dst, uint32 imm)
+{
+   Rex(p, w, 0, 0, dst, false);
+
+   if((int32)imm >= -128 && (int32)imm < 128)
+   {
+      Put8(p, 0x83);
+      Put8(p, 0xC0 | (op << 3) | (dst & 7));
+      Put8(p, imm);
+   }
+   else
+   {
+      Put8(p, 0x81);
+      Put8(p, 0xC0 | (op << 3) | (dst & 7));
+      Put32(p, imm);
+   }
+}
+
+static void ShiftRI(uint8 *&p, bool w, unsigned op, unsigned reg, unsigned count)
+{
+   InsR(p, w, 0xC1, op, reg);
+   Put8(p, count);
+}
+
+static void ShiftRCL(uint8 *&p, bool w, unsigned op, unsigned reg)
+{
+   InsR(p, w, 0xD3, op, reg);
+}
+
+static uint8 *Jcc(uint8 *&p, unsigned cc)
+{
+   uint8 *rel;
+
+   Put8(p, 0x0F);
+   Put8(p, 0x80 | cc);
+   rel = p;
+   Put32(p, 0);
+   return rel;
+}
+
+static uint8 *Jmp(uint8 *&p)
+{
+   uint8 *rel;
+
+   Put8(p, 0xE9);
+   rel = p;
+   Put32(p, 0);
+   return rel;
+}
+
+static uint8 *Jcc8(uint8 *&p, unsigned cc)
+{
+   Put8(p, 0x70 | cc);
+   Put8(p, 0);
+   return p - 1;
+}
+
+static void Patch(uint8 *rel, const uint8 *target)
+{
+   const int32 d = (int32)(target - (rel + 4));
+
+   memcpy(rel, &d, 4);
+}
+
+static void Patch8(uint8 *rel, const uint8 *target)
+{
+   *rel = (uint8)(target - (rel + 1));
+}
+
+static void CallAbs(uint8 *&p, const void *func)
+{
+   MovRI64(p, RAX, (uint64)(uintptr_t)func);
+   Put8(p, 0xFF);	/* call rax */
+   Put8(p, 0xD0);
+}
+
+/*
+ * Offsets(from the V810 object, in rbx) and compile state shared by the emitters below.
+ */
+enum { OV_X86 = -1, OV_ZERO = -2 };
+enum { CY_X86 = -1 };
+
+struct JITExit
+{
+   uint8 *rel;
+   uint8 *pc_ptr;
+   uint8 *pc_base;
+   bool lo_store;
+   int32 lo;
+   uint32 clocks;	/* JITCtx::clocks where it was taken */
+};
+
+struct JITSlowLoad
+{
+   uint8 *rel;
+   uint8 *resume;
+   const void *helper;
+   unsigned reg;
+   bool lo_store;
+   int32 lo;
+   uint8 *next_ptr;
+   uint32 clocks;	/* JITCtx::clocks before the load */
+};
+
+struct JITCtx
+{
+   int32 preg;
+   int32 psw;
+   int32 sreg;
+   int32 pc_ptr;
+   int32 pc_base;
+   int32 lastop;
+   int32 next_event_ts;
+   int32 ts;
+   int32 fastmap;
+   int32 datamap;
+   int32 bus32;
+
+   uint8 *epilogue;
+   uint8 *block_ptr;
+   uint8 *block_base;
+   V810_JIT *jit;
+   int32 link;		/* Offset of V810::JITLink */
+
+   uint32 clocks;	/* Cycles of the instructions emitted so far not yet added to r12d */
+
+   JITExit exits[JIT_MAX_INSNS * 4 + 4];
+   unsigned exit_count;
+
+   /* Jumps to the exit code shared by the block; tail_lo if lastop is in edx. */
+   uint8 *tail_rel[JIT_MAX_INSNS * 4 + 8];
+   bool tail_lo[JIT_MAX_INSNS * 4 + 8];
+   unsigned tail_count;
+
+   JITSlowLoad slow[JIT_MAX_INSNS * 2];
+   unsigned slow_count;
+};
+
+static INLINE int32 GR(const JITCtx &c, unsigned r)
+{
+   return c.preg + r * 4;
+}
+
+static void LoadGR(uint8 *&p, const JITCtx &c, unsigned host, unsigned r)
+{
+   if(!r)
+      InsR(p, false, 0x31, host, host);		/* xor host, host */
+   else
+      InsM(p, false, 0x8B, host, RBX, -1, 1, GR(c, r));
+}
+
+static void StoreGR(uint8 *&p, const JITCtx &c, unsigned r, unsigned host)
+{
+   InsM(p, false, 0x89, host, RBX, -1, 1, GR(c, r));
+}
+
+static void StoreMI(uint8 *&p, int32 disp, uint32 imm)
+{
+   InsM(p, false, 0xC7, 0, RBX, -1, 1, disp);
+   Put32(p, imm);
+}
+
+/*
+ * Cycles are counted at compile time and only added to r12d where the timestamp is looked at: before
+ * memory accesses(their helpers and wait states see it) and at exits.
+ */
+static void AddClock(JITCtx &c, uint32 n)
+{
+   c.clocks += n;
+}
+
+static void FlushClocks(uint8 *&p, JITCtx &c)
+{
+   if(c.clocks)
+      AluRI(p, false, ALU_ADD, R12, c.clocks);
+   c.clocks = 0;
+}
+
+/*
+ * Merge the flags left by the last x86 ALU instruction into PSW; mask is the set of PSW bits the
+ * V810 instruction writes.  ov/cy name a register holding 0 or 1 to use instead of OF/CF(CF must
+ * then be clear), or OV_ZERO.  Clobbers rax and rsi.
+ */
+static void EmitFlags(uint8 *&p, const JITCtx &c, uint32 mask, int ov, int cy)
+{
+   Put8(p, 0x9F);					/* lahf */
+   if(ov == OV_X86)
+      InsR(p, false, 0x0F90 | CC_O, 0, RAX);	/* seto al */
+
+   Put8(p, 0x0F);					/* movzx esi, ah */
+   Put8(p, 0xB6);
+   Put8(p, 0xC0 | (RSI << 3) | 4);
+   InsM(p, false, 0x0FB6, RSI, R13, RSI, 1, 0);	/* movzx esi, byte [r13 + rsi] */
+
+   if(ov == OV_X86)
+   {
+      InsR(p, false, 0x0FB6, RAX, RAX, true);	/* movzx eax, al */
+      InsM(p, false, 0x8D, RSI, RSI, RAX, 4, 0);
+   }
+   else if(ov >= 0)
+      InsM(p, false, 0x8D, RSI, RSI, ov, 4, 0);
+
+   if(cy >= 0)
+      InsM(p, false, 0x8D, RSI, RSI, cy, 8, 0);
+
+   if(mask != 0xF)
+      AluRI(p, false, ALU_AND, RSI, mask);
+
+   InsM(p, false, 0x8B, RAX, RBX, -1, 1, c.psw);
+   AluRI(p, false, ALU_AND, RAX, ~mask);
+   InsR(p, false, 0x09, RSI, RAX);		/* or eax, esi */
+   InsM(p, false, 0x89, RAX, RBX, -1, 1, c.psw);
+}
+
+/* Evaluate V810 condition cond(not T/F) from PSW; returns the x86 condition code that's true when it holds.  Clobbers rax, rcx. */
+static unsigned EmitCond(uint8 *&p, const JITCtx &c, unsigned cond)
+{
+   static const uint8 simple_mask[8] = { PSW_OV, PSW_CY, PSW_Z, PSW_Z | PSW_CY, PSW_S, 0, 0, 0 };
+
+   InsM(p, false, 0x8B, RAX, RBX, -1, 1, c.psw);
+
+   switch(cond & 7)
+   {
+      case COND_LT:
+      case COND_LE:
+         InsR(p, false, 0x89, RAX, RCX);		/* mov ecx, eax */
+         ShiftRI(p, false, SH_SHR, RCX, 1);
+         InsR(p, false, 0x31, RAX, RCX);		/* xor ecx, eax: bit 1 = S ^ OV */
+         if((cond & 7) == COND_LT)
+         {
+            Put8(p, 0xF6);				/* test cl, 2 */
+            Put8(p, 0xC1);
+            Put8(p, 0x02);
+         }
+         else
+         {
+            AluRI(p, false, ALU_AND, RCX, 2);
+            AluRI(p, false, ALU_AND, RAX, PSW_Z);
+            InsR(p, false, 0x09, RAX, RCX);		/* or ecx, eax */
+         }
+         break;
+
+      default:
+         Put8(p, 0xA8);				/* test al, imm8 */
+         Put8(p, simple_mask[cond & 7]);
+         break;
+   }
+
+   return (cond & 8) ? CC_E : CC_NE;
+}
+
+/* Leave the block, resuming at pc_ptr/pc_base. */
+static void EmitExit(uint8 *&p, JITCtx &c, uint8 *pc_ptr, uint8 *pc_base, bool lo_store, int32 lo)
+{
+   FlushClocks(p, c);
+
+   if(pc_base == c.block_base)
+   {
+      /* Same PC_base(so within the 26-bit branch range); rcx = PC_ptr - block start, edx = lastop */
+      InsR(p, true, 0xC7, 0, RCX);
+      Put32(p, (uint32)(pc_ptr - c.block_ptr));
+      if(lo_store)
+         MovRI(p, RDX, lo);
+      c.tail_lo[c.tail_count] = lo_store;
+      c.tail_rel[c.tail_count++] = Jmp(p);
+      return;
+   }
+
+   if(lo_store)
+      StoreMI(p, c.lastop, lo);
+
+   MovRI64(p, RAX, (uint64)(uintptr_t)pc_ptr);
+   InsM(p, true, 0x89, RAX, RBX, -1, 1, c.pc_ptr);
+   MovRI64(p, RAX, (uint64)(uintptr_t)pc_base);
+   InsM(p, true, 0x89, RAX, RBX, -1, 1, c.pc_base);
+   Patch(Jmp(p), c.epilogue);
+}
+
+/*
+ * Leave the block for a fixed guest address; once the block there is compiled, JIT_Exec() patches
+ * the jump to go straight to it(which checks for events on entry).
+ */
+static void EmitChainExit(uint8 *&p, JITCtx &c, uint8 *pc_ptr, uint8 *pc_base, bool lo_store, int32 lo, bool r0_dirty)
+{
+   const int32 li = c.jit->link_count++;
+   V810_JITLink *l = &c.jit->links[li];
+
+   FlushClocks(p, c);
+   if(lo_store)
+      StoreMI(p, c.lastop, lo);
+
+   if(r0_dirty)
+      StoreMI(p, GR(c, 0), 0);
+   l->rel = Jmp(p);
+   l->stub = p;
+   l->pc_ptr = pc_ptr;
+   l->pc_base = pc_base;
+   l->next = -1;
+   l->linked = false;
+
+   Patch(l->rel, p);
+   StoreMI(p, c.link, li);
+   EmitExit(p, c, pc_ptr, pc_base, false, 0);
+}
+
+/*
+ * Leave the block for the PC_ptr/PC_base just stored, with rdx = PC_base; if jump_cache[] has the
+ * block there, go straight to it(which checks for events on entry) instead of back to JIT_Exec().
+ */
+static void EmitJumpLookup(uint8 *&p, const JITCtx &c)
+{
+   InsM(p, true, 0x8B, RCX, RBX, -1, 1, c.pc_ptr);
+   InsR(p, false, 0x89, RCX, RAX);
+   ShiftRI(p, false, SH_SHR, RAX, 1);
+   AluRI(p, false, ALU_AND, RAX, JIT_JUMP_CACHE_SIZE - 1);	/* JIT_JumpHash() */
+   InsM(p, true, 0x8D, RAX, RAX, RAX, 2, 0);			/* lea rax, [rax + rax * 2] */
+   MovRI64(p, RSI, (uint64)(uintptr_t)c.jit->jump_cache);
+
+   InsM(p, true, 0x3B, RCX, RSI, RAX, 8, offsetof(V810_JITJump, pc_ptr));
+   Patch(Jcc(p, CC_NE), c.epilogue);
+   InsM(p, true, 0x3B, RDX, RSI, RAX, 8, offsetof(V810_JITJump, pc_base));
+   Patch(Jcc(p, CC_NE), c.epilogue);
+   InsM(p, false, 0xFF, 4, RSI, RAX, 8, offsetof(V810_JITJump, code));	/* jmp [code] */
+}
+
+static void EmitExitTails(uint8 *&p, JITCtx &c)
+{
+   uint8 *tail_lo = p;
+   uint8 *tail;
+
+   InsM(p, false, 0x89, RDX, RBX, -1, 1, c.lastop);
+   tail = p;
+   MovRI64(p, RAX, (uint64)(uintptr_t)c.block_ptr);
+   InsR(p, true, 0x01, RCX, RAX);			/* add rax, rcx */
+   InsM(p, true, 0x89, RAX, RBX, -1, 1, c.pc_ptr);
+   Patch(Jmp(p), c.epilogue);
+
+   for(unsigned int i = 0; i < c.tail_count; i++)
+      Patch(c.tail_rel[i], c.tail_lo[i] ? tail_lo : tail);
+}
+
+static void AddExit(JITCtx &c, uint8 *rel, uint8 *pc_ptr, uint8 *pc_base, bool lo_store, int32 lo)
+{
+   JITExit *e = &c.exits[c.exit_count++];
+
+   e->rel      = rel;
+   e->pc_ptr   = pc_ptr;
+   e->pc_base  = pc_base;
+   e->lo_store = lo_store;
+   e->lo       = lo;
+   e->clocks   = c.clocks;
+}
+
+/* rdx = FastMap[] or DataMap[](map is c.fastmap or c.datamap) entry for the address in eax; clobbers ecx. */
+static void EmitMapPage(uint8 *&p, int32 map)
+{
+   InsR(p, false, 0x89, RAX, RCX);
+   ShiftRI(p, false, SH_SHR, RCX, V810_FAST_MAP_SHIFT);
+   AluRI(p, false, ALU_AND, RCX, V810_FAST_MAP_ADDR_MASK >> V810_FAST_MAP_SHIFT);
+   InsM(p, true, 0x8B, RDX, RBX, RCX, 8, map);	/* mov rdx, map[ecx] */
+}
+
+static void EmitCallHelper(uint8 *&p, const JITCtx &c, const void *helper)
+{
+   InsM(p, false, 0x89, R12, RBX, -1, 1, c.ts);	/* mov [ts], r12d */
+   InsR(p, true, 0x89, RBX, RDI);			/* mov rdi, rbx */
+   CallAbs(p, helper);
+   InsM(p, false, 0x8B, R12, RBX, -1, 1, c.ts);	/* mov r12d, [ts] */
+}
+
+/*
+ * Helpers called from recompiled code; same semantics as the corresponding opcodes in v810_oploop.inc.
+ * They return non-zero when the block must be left after the instruction.
+ */
+uint32 V810::JIT_LD_B(V810 *cpu, uint32 A, uint32 reg)
+{
+   v810_timestamp_t &timestamp = cpu->JITTimestamp;
+
+   timestamp++;
+   cpu->P_REG[reg] = sign_8(cpu->MemRead8(timestamp, A));
+
+   if(cpu->lastop >= 0)
+      timestamp += (cpu->lastop == LASTOP_LD) ? 1 : 2;
+   cpu->lastop = LASTOP_LD;
+
+   return cpu->IPendingCache;
+}
+
+uint32 V810::JIT_LD_H(V810 *cpu, uint32 A, uint32 reg)
+{
+   v810_timestamp_t &timestamp = cpu->JITTimestamp;
+
+   timestamp++;
+   cpu->P_REG[reg] = sign_16(cpu->MemRead16(timestamp, A));
+
+   if(cpu->lastop >= 0)
+      timestamp += (cpu->lastop == LASTOP_LD) ? 1 : 2;
+   cpu->lastop = LASTOP_LD;
+
+   return cpu->IPendingCache;
+}
+
+uint32 V810::JIT_LD_W(V810 *cpu, uint32 A, uint32 reg)
+{
+   v810_timestamp_t &timestamp = cpu->JITTimestamp;
+
+   timestamp++;
+
+   if(cpu->MemReadBus32[A >> 24])
+   {
+      cpu->P_REG[reg] = cpu->MemRead32(timestamp, A);
+
+      if(cpu->lastop >= 0)
+         timestamp += (cpu->lastop == LASTOP_LD) ? 1 : 2;
+   }
+   else
+   {
+      cpu->P_REG[reg] = cpu->MemReadWord(timestamp, A);
+
+      if(cpu->lastop >= 0)
+         timestamp += (cpu->lastop == LASTOP_LD) ? 3 : 4;
+   }
+   cpu->lastop = LASTOP_LD;
+
+   return cpu->IPendingCache;
+}
+
+uint32 V810::JIT_ST_B(V810 *cpu, uint32 A, uint32 V)
+{
+   v810_timestamp_t &timestamp = cpu->JITTimestamp;
+   uint32 ret;
+
+   timestamp++;
+   cpu->DataStore8(timestamp, A, V & 0xFF);
+
+   if(cpu->lastop == LASTOP_ST)
+      timestamp++;
+   cpu->lastop = LASTOP_ST;
+
+   ret = cpu->IPendingCache | cpu->JITStop;
+   cpu->JITStop = false;
+   return ret;
+}
+
+uint32 V810::JIT_ST_H(V810 *cpu, uint32 A, uint32 V)
+{
+   v810_timestamp_t &timestamp = cpu->JITTimestamp;
+   uint32 ret;
+
+   timestamp++;
+   cpu->DataStore16(timestamp, A, V & 0xFFFF);
+
+   if(cpu->lastop == LASTOP_ST)
+      timestamp++;
+   cpu->lastop = LASTOP_ST;
+
+   ret = cpu->IPendingCache | cpu->JITStop;
+   cpu->JITStop = false;
+   return ret;
+}
+
+uint32 V810::JIT_ST_W(V810 *cpu, uint32 A, uint32 V)
+{
+   v810_timestamp_t &timestamp = cpu->JITTimestamp;
+   uint32 ret;
+
+   timestamp++;
+
+   if(cpu->MemWriteBus32[A >> 24])
+   {
+      cpu->DataStore32(timestamp, A, V);
+
+      if(cpu->lastop == LASTOP_ST)
+         timestamp++;
+   }
+   else
+   {
+      cpu->DataStore32(timestamp, A, V);
+
+      if(cpu->lastop == LASTOP_ST)
+         timestamp += 3;
+   }
+   cpu->lastop = LASTOP_ST;
+
+   ret = cpu->IPendingCache | cpu->JITStop;
+   cpu->JITStop = false;
+   return ret;
+}
+
+static INLINE uint32 JIT_Hash(const uint8 *pc_ptr)
+{
+   return ((uintptr_t)pc_ptr >> 1) & (JIT_HASH_SIZE - 1);
+}
+
+static INLINE uint32 JIT_JumpHash(const uint8 *pc_ptr)
+{
+   return ((uintptr_t)pc_ptr >> 1) & (JIT_JUMP_CACHE_SIZE - 1);
+}
+
+bool V810::JIT_Init(void)
+{
+   unsigned int eax, ebx, ecx, edx;
+   uint8 *p;
+
+   /* LAHF isn't available in 64-bit mode on some early x86-64 CPUs. */
+   if(!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || !(ecx & 1))
+      return false;
+
+   if(!(JIT = (V810_JIT *)calloc(1, sizeof(V810_JIT))))
+      return false;
+
+   JIT->buffer = (uint8 *)mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if(JIT->buffer == MAP_FAILED)
+   {
+      free(JIT);
+      JIT = NULL;
+      return false;
+   }
+
+   for(unsigned int i = 0; i < 256; i++)
+      JIT->flag_lut[i] = ((i & 0x40) ? PSW_Z : 0) | ((i & 0x80) ? PSW_S : 0) | ((i & 0x01) ? PSW_CY : 0);
+
+   /* int32 enter(V810 *cpu, int32 timestamp, uint8 *code) */
+   p = JIT->buffer;
+   JIT->enter = (int32 (*)(V810 *, int32, uint8 *))p;
+   Put8(p, 0x53);				/* push rbx */
+   Put8(p, 0x41); Put8(p, 0x54);		/* push r12 */
+   Put8(p, 0x41); Put8(p, 0x55);		/* push r13 */
+   InsR(p, true, 0x89, RDI, RBX);		/* mov rbx, rdi */
+   InsR(p, false, 0x89, RSI, R12);		/* mov r12d, esi */
+   MovRI64(p, R13, (uint64)(uintptr_t)JIT->flag_lut);
+   Put8(p, 0xFF); Put8(p, 0xE2);		/* jmp rdx */
+
+   JIT->epilogue = p;
+   InsR(p, false, 0x89, R12, RAX);		/* mov eax, r12d */
+   Put8(p, 0x41); Put8(p, 0x5D);		/* pop r13 */
+   Put8(p, 0x41); Put8(p, 0x5C);		/* pop r12 */
+   Put8(p, 0x5B);				/* pop rbx */
+   Put8(p, 0xC3);				/* ret */
+
+   JIT->code_start = (uint8 *)(((uintptr_t)p + 15) & ~(uintptr_t)15);
+
+   JIT_Flush();
+
+   return true;
+}
+
+void V810::JIT_Kill(void)
+{
+   if(!JIT)
+      return;
+
+   munmap(JIT->buffer, JIT_BUFFER_SIZE);
+
+   for(unsigned int i = 0; i < V810_FAST_MAP_MAX_REGIONS; i++)
+      free(JIT->granules[i]);
+
+   free(JIT);
+   JIT = NULL;
+}
+
+void V810::JIT_Flush(void)
+{
+   JIT->ptr = JIT->code_start;
+   JIT->block_count = 0;
+   JIT->free_head = -1;
+   JIT->link_count = 0;
+   JITLink = -1;
+
+   for(unsigned int i = 0; i < JIT_HASH_SIZE; i++)
+      JIT->hash_head[i] = -1;
+
+   memset(JIT->jump_cache, 0, sizeof(JIT->jump_cache));
+   memset(JITNoCode, 0, sizeof(JITNoCode));
+   memset(JITCodeMap, 0, sizeof(JITCodeMap));
+
+   for(unsigned int r = 0; r < FastMapRegionCount; r++)
+   {
+      if(JIT->granules[r])
+      {
+         for(uint32 g = 0; g < (FastMapRegions[r].length >> JIT_GRANULE_SHIFT) + 1; g++)
+         {
+            JIT->granules[r][g].head = -1;
+            JIT->granules[r][g].smc_count = 0;
+         }
+      }
+   }
+}
+
+/* Granule g of FastMapRegions[r] got its first block(delta = 1), or lost all of them(delta = -1). */
+void V810::JIT_CountGranule(unsigned int r, uint32 g, int32 delta)
+{
+   const uint8 *start = FastMapRegions[r].data + ((size_t)g << JIT_GRANULE_SHIFT);
+   const uint8 *end = FastMapRegions[r].data + std::min<size_t>((size_t)(g + 1) << JIT_GRANULE_SHIFT, FastMapRegions[r].length);
+   const uint32 first = ((uintptr_t)start >> JIT_GRANULE_SHIFT) & (V810_JIT_CODE_MAP_SIZE - 1);
+   const uint32 last = ((uintptr_t)(end - 1) >> JIT_GRANULE_SHIFT) & (V810_JIT_CODE_MAP_SIZE - 1);
+
+   JITCodeMap[first] += delta;
+   if(last != first)
+      JITCodeMap[last] += delta;
+}
+
+void V810::JIT_Invalidate(const uint8 *ptr)
+{
+   for(unsigned int r = 0; r < FastMapRegionCount; r++)
+   {
+      const size_t offs = ptr - FastMapRegions[r].data;
+
+      if(offs < FastMapRegions[r].length)
+      {
+         V810_JITGranule *gran;
+
+         if(!JIT->granules[r])
+            return;
+
+         gran = &JIT->granules[r][offs >> JIT_GRANULE_SHIFT];
+
+         if(gran->head < 0)
+            return;
+
+         for(int32 i = gran->head; i >= 0; i = JIT->blocks[i].gran_next)
+         {
+            V810_JITBlock *b = &JIT->blocks[i];
+            int32 *link = &JIT->hash_head[JIT_Hash(b->pc_ptr)];
+            V810_JITJump *jump = &JIT->jump_cache[JIT_JumpHash(b->pc_ptr)];
+            const uint8 **no_code = &JITNoCode[((uintptr_t)b->pc_ptr >> 1) & (V810_JIT_NO_CODE_SIZE - 1)];
+
+            while(*link != i)
+               link = &JIT->blocks[*link].hash_next;
+            *link = b->hash_next;
+            b->hash_next = JIT->free_head;
+            JIT->free_head = i;
+
+            /* Unlink jumps into it */
+            for(int32 li = b->in_links; li >= 0; li = JIT->links[li].next)
+            {
+               Patch(JIT->links[li].rel, JIT->links[li].stub);
+               JIT->links[li].linked = false;
+            }
+            b->in_links = -1;
+
+            if(jump->pc_ptr == b->pc_ptr && jump->pc_base == b->pc_base)
+               jump->pc_ptr = NULL;
+
+            if(*no_code == b->pc_ptr)
+               *no_code = NULL;
+
+            /* The block being run may have been discarded. */
+            if(b->code)
+            {
+               JITStop = true;
+               gran->smc_count++;
+            }
+         }
+         gran->head = -1;
+         JIT_CountGranule(r, offs >> JIT_GRANULE_SHIFT, -1);
+         return;
+      }
+   }
+}
+
+bool V810::JIT_Exec(v810_timestamp_t &timestamp)
+{
+   V810_JITJump *jump = &JIT->jump_cache[JIT_JumpHash(PC_ptr)];
+   V810_JITBlock *b = NULL;
+   v810_timestamp_t new_timestamp;
+
+   /* The chainable exit last left through went somewhere the interpreter ran instead. */
+   if(JITLink >= 0 && (JIT->links[JITLink].pc_ptr != PC_ptr || JIT->links[JITLink].pc_base != PC_base))
+      JITLink = -1;
+
+   /* Came back to a block run recently, and not through a chainable exit that could be linked. */
+   if(jump->pc_ptr == PC_ptr && jump->pc_base == PC_base && JITLink < 0)
+   {
+      JITStop = false;
+      new_timestamp = JIT->enter(this, timestamp, jump->code);
+      if(new_timestamp == timestamp)
+         return false;
+
+      timestamp = new_timestamp;
+      return true;
+   }
+
+   for(int32 i = JIT->hash_head[JIT_Hash(PC_ptr)]; i >= 0; i = JIT->blocks[i].hash_next)
+   {
+      if(JIT->blocks[i].pc_ptr == PC_ptr && JIT->blocks[i].pc_base == PC_base)
+      {
+         b = &JIT->blocks[i];
+         break;
+      }
+   }
+
+   if(!b)
+      b = JIT_Compile();
+
+   if(!b || !b->code)
+   {
+      /* Let the interpreter run it without looking it up again(until the code there is rewritten). */
+      JITNoCode[((uintptr_t)PC_ptr >> 1) & (V810_JIT_NO_CODE_SIZE - 1)] = PC_ptr;
+      JITLink = -1;
+      return false;
+   }
+
+   /* If we got here through a chainable exit to this block, link it. */
+   if(JITLink >= 0)
+   {
+      V810_JITLink *l = &JIT->links[JITLink];
+
+      if(!l->linked && l->pc_ptr == b->pc_ptr && l->pc_base == b->pc_base)
+      {
+         Patch(l->rel, b->code);
+         l->linked = true;
+         l->next = b->in_links;
+         b->in_links = JITLink;
+      }
+      JITLink = -1;
+   }
+
+   jump->pc_ptr  = b->pc_ptr;
+   jump->pc_base = b->pc_base;
+   jump->code    = b->code;
+
+   JITStop = false;
+   new_timestamp = JIT->enter(this, timestamp, b->code);
+
+   /* No instruction was executed(divide by zero at the start of the block). */
+   if(new_timestamp == timestamp)
+      return false;
+
+   timestamp = new_timestamp;
+   return true;
+}
+
+V810_JITBlock *V810::JIT_Compile(void)
+{
+   V810_JIT *J = JIT;
+   V810_JITBlock *b;
+   int32 bi;
+   int region = -1;
+   uint8 *gran_end = NULL;
+
+   V810_JITGranule *gran = NULL;
+
+   if((J->free_head < 0 && J->block_count == JIT_MAX_BLOCKS) || J->link_count > JIT_MAX_LINKS - 2 || (J->buffer + JIT_BUFFER_SIZE - J->ptr) < JIT_BUFFER_SLACK)
+      JIT_Flush();
+
+   for(unsigned int r = 0; r < FastMapRegionCount; r++)
+   {
+      const size_t offs = PC_ptr - FastMapRegions[r].data;
+
+      if(offs < FastMapRegions[r].length)
+      {
+         const uint32 g = offs >> JIT_GRANULE_SHIFT;
+         const uint32 gran_count = (FastMapRegions[r].length >> JIT_GRANULE_SHIFT) + 1;
+
+         if(!J->granules[r])
+         {
+            if(!(J->granules[r] = (V810_JITGranule *)malloc(gran_count * sizeof(V810_JITGranule))))
+               return NULL;
+
+            for(uint32 i = 0; i < gran_count; i++)
+            {
+               J->granules[r][i].head = -1;
+               J->granules[r][i].smc_count = 0;
+            }
+         }
+
+         gran = &J->granules[r][g];
+
+         /* Code that keeps getting rewritten isn't worth recompiling(or remembering). */
+         if(gran->smc_count >= JIT_SMC_LIMIT)
+            return NULL;
+
+         region = r;
+         gran_end = FastMapRegions[r].data + std::min<size_t>((size_t)(g + 1) << JIT_GRANULE_SHIFT, FastMapRegions[r].length);
+         break;
+      }
+   }
+
+   if(J->free_head >= 0)
+   {
+      bi = J->free_head;
+      J->free_head = J->blocks[bi].hash_next;
+   }
+   else
+      bi = J->block_count++;
+   b = &J->blocks[bi];
+   b->pc_ptr  = PC_ptr;
+   b->pc_base = PC_base;
+   b->code    = NULL;
+   b->hash_next = J->hash_head[JIT_Hash(PC_ptr)];
+   b->gran_next = -1;
+   b->in_links = -1;
+   J->hash_head[JIT_Hash(PC_ptr)] = bi;
+
+   /* Not in a FastMap region(or in the trampoline past its end); leave it to the interpreter. */
+   if(region < 0)
+      return b;
+
+   if(gran->head < 0)
+      JIT_CountGranule(region, (PC_ptr - FastMapRegions[region].data) >> JIT_GRANULE_SHIFT, 1);
+   b->gran_next = gran->head;
+   gran->head = bi;
+
+   {
+      JITCtx c;
+      uint8 *p = J->ptr;
+      uint8 *const code = p;
+      uint8 *ip = PC_ptr;
+      unsigned count = 0;
+      bool lo_known = false;	/* lastop is known at compile time(lo) */
+      bool lo_mem = true;	/* lastop in memory is current */
+      int32 lo = 0;
+      bool r0_dirty = false;
+      bool ended = false;
+
+      c.preg          = (int32)((uint8 *)&P_REG[0] - (uint8 *)this);
+      c.sreg          = (int32)((uint8 *)&S_REG[0] - (uint8 *)this);
+      c.psw           = (int32)((uint8 *)&S_REG[PSW] - (uint8 *)this);
+      c.pc_ptr        = (int32)((uint8 *)&PC_ptr - (uint8 *)this);
+      c.pc_base       = (int32)((uint8 *)&PC_base - (uint8 *)this);
+      c.lastop        = (int32)((uint8 *)&lastop - (uint8 *)this);
+      c.next_event_ts = (int32)((uint8 *)&next_event_ts - (uint8 *)this);
+      c.ts            = (int32)((uint8 *)&JITTimestamp - (uint8 *)this);
+      c.fastmap       = (int32)((uint8 *)&FastMap[0] - (uint8 *)this);
+      c.datamap       = (int32)((uint8 *)&DataMap[0] - (uint8 *)this);
+      c.bus32         = (int32)((uint8 *)&MemReadBus32[0] - (uint8 *)this);
+      c.link          = (int32)((uint8 *)&JITLink - (uint8 *)this);
+      c.jit           = J;
+      c.epilogue      = J->epilogue;
+      c.block_ptr     = PC_ptr;
+      c.block_base    = PC_base;
+      c.tail_count    = 0;
+      c.exit_count    = 0;
+      c.slow_count    = 0;
+      c.clocks        = 0;
+
+      /*
+       * Events are checked here, on entry(including the loop back from a branch to the start of the
+       * block), instead of after every instruction as the interpreter does.
+       */
+      InsM(p, false, 0x3B, R12, RBX, -1, 1, c.next_event_ts);
+      AddExit(c, Jcc(p, CC_GE), PC_ptr, PC_base, false, 0);
+
+      while(!ended)
+      {
+         const uint32 pc = (uint32)(ip - PC_base);
+         const uint16 tmpop = LoadU16_LE((uint16 *)ip);
+         const unsigned op6 = tmpop >> 10;
+         const unsigned op7 = tmpop >> 9;
+         const unsigned size = (op6 >= 0x28) ? 4 : 2;
+         const uint16 ext = (size == 4 && ip + 4 <= gran_end) ? LoadU16_LE((uint16 *)(ip + 2)) : 0;
+         /* Format I/II/V/VI fields */
+         const unsigned reg1 = tmpop & 0x1F;
+         const unsigned reg2 = (tmpop >> 5) & 0x1F;
+         uint8 *const next = ip + size;
+         int32 new_lo = op7;
+         bool writes_r0 = false;
+         bool supported;
+
+         switch(op6)
+         {
+            case MOV: case ADD: case SUB: case CMP: case SHL: case SHR: case SAR:
+            case MUL: case MULU: case OR: case AND: case XOR: case NOT:
+            case JMP:
+            case MOV_I: case ADD_I: case SETF: case CMP_I: case SHL_I: case SHR_I: case SAR_I:
+            case STSR:
+            case MOVEA: case ADDI: case JR: case JAL: case ORI: case ANDI: case XORI: case MOVHI:
+            case LD_B: case LD_H: case LD_W: case ST_B: case ST_H: case ST_W:
+               supported = true;
+               break;
+
+            case DIV: case DIVU:
+               /* Division by r0 always raises an exception. */
+               supported = (reg1 != 0);
+               break;
+
+            default:
+               /* Branches */
+               supported = (op6 >= 0x20 && op6 < 0x28);
+               break;
+         }
+
+         if(!supported || next > gran_end || count == JIT_MAX_INSNS || (J->buffer + JIT_BUFFER_SIZE - p) < JIT_BLOCK_SLACK)
+         {
+            /* Entering the block would cost more than it saves. */
+            if(!count || (!supported && count < JIT_MIN_INSNS))
+               return b;
+
+            if(supported)
+               EmitChainExit(p, c, ip, PC_base, !lo_mem, lo, r0_dirty);
+            else
+               EmitExit(p, c, ip, PC_base, !lo_mem, lo);
+            break;
+         }
+
+         if(r0_dirty)
+         {
+            StoreMI(p, GR(c, 0), 0);
+            r0_dirty = false;
+         }
+
+         switch(op6)
+         {
+            case MOV:
+               LoadGR(p, c, RCX, reg1);
+               StoreGR(p, c, reg2, RCX);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case ADD:
+            case SUB:
+            case CMP:
+               LoadGR(p, c, RCX, reg2);
+               if(reg1)
+                  InsM(p, false, (op6 == ADD) ? 0x03 : (op6 == SUB) ? 0x2B : 0x3B, RCX, RBX, -1, 1, GR(c, reg1));
+               else
+                  AluRI(p, false, (op6 == ADD) ? ALU_ADD : (op6 == SUB) ? ALU_SUB : ALU_CMP, RCX, 0);
+               if(op6 != CMP)
+               {
+                  StoreGR(p, c, reg2, RCX);
+                  writes_r0 = !reg2;
+               }
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV | PSW_CY, OV_X86, CY_X86);
+               AddClock(c, 1);
+               break;
+
+            case SHL:
+            case SHR:
+            case SAR:
+               /* Shift in 64 bits so a count of 0 needs no special casing; the last bit shifted out
+                * ends up in r8. */
+               LoadGR(p, c, RDX, reg2);
+               if(op6 != SHL)
+                  ShiftRI(p, true, SH_SHL, RDX, 32);
+               LoadGR(p, c, RCX, reg1);
+               AluRI(p, false, ALU_AND, RCX, 0x1F);
+               ShiftRCL(p, true, (op6 == SHL) ? SH_SHL : (op6 == SHR) ? SH_SHR : SH_SAR, RDX);
+               InsR(p, true, 0x89, RDX, R8);		/* mov r8, rdx */
+               ShiftRI(p, true, SH_SHR, R8, (op6 == SHL) ? 32 : 31);
+               AluRI(p, false, ALU_AND, R8, 1);
+               if(op6 != SHL)
+                  ShiftRI(p, true, SH_SHR, RDX, 32);
+               StoreGR(p, c, reg2, RDX);
+               InsR(p, false, 0x85, RDX, RDX);		/* test edx, edx */
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV | PSW_CY, OV_ZERO, R8);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case SHL_I:
+            case SHR_I:
+            case SAR_I:
+               LoadGR(p, c, RCX, reg2);
+               if(reg1)
+                  ShiftRI(p, false, (op6 == SHL_I) ? SH_SHL : (op6 == SHR_I) ? SH_SHR : SH_SAR, RCX, reg1);
+               else
+                  InsR(p, false, 0x85, RCX, RCX);	/* test ecx, ecx */
+               StoreGR(p, c, reg2, RCX);
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV | PSW_CY, OV_ZERO, CY_X86);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case OR:
+            case AND:
+            case XOR:
+               LoadGR(p, c, RCX, reg2);
+               if(reg1)
+                  InsM(p, false, (op6 == OR) ? 0x0B : (op6 == AND) ? 0x23 : 0x33, RCX, RBX, -1, 1, GR(c, reg1));
+               else
+                  AluRI(p, false, (op6 == OR) ? ALU_OR : (op6 == AND) ? ALU_AND : ALU_XOR, RCX, 0);
+               StoreGR(p, c, reg2, RCX);
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV, OV_X86, CY_X86);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case NOT:
+               LoadGR(p, c, RCX, reg1);
+               InsR(p, false, 0xF7, 2, RCX);		/* not ecx */
+               StoreGR(p, c, reg2, RCX);
+               InsR(p, false, 0x85, RCX, RCX);
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV, OV_X86, CY_X86);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case MUL:
+            case MULU:
+               LoadGR(p, c, RAX, reg2);
+               LoadGR(p, c, RCX, reg1);
+               InsR(p, false, 0xF7, (op6 == MUL) ? 5 : 4, RCX);	/* imul/mul ecx */
+               InsR(p, false, 0x0F90 | CC_O, 0, R8, true);		/* seto r8b */
+               InsR(p, false, 0x0FB6, R8, R8, true);			/* movzx r8d, r8b */
+               StoreGR(p, c, 30, RDX);
+               StoreGR(p, c, reg2, RAX);
+               InsR(p, false, 0x89, RAX, RCX);
+               InsR(p, false, 0x85, RCX, RCX);
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV, R8, CY_X86);
+               AddClock(c, 13);
+               new_lo = -1;
+               writes_r0 = !reg2;
+               break;
+
+            case DIV:
+            case DIVU:
+            {
+               uint8 *special = NULL;
+               uint8 *done = NULL;
+
+               LoadGR(p, c, RCX, reg1);
+               InsR(p, false, 0x85, RCX, RCX);
+               /* Divide by zero raises an exception; let the interpreter handle it. */
+               AddExit(c, Jcc(p, CC_E), ip, PC_base, !lo_mem, lo);
+               LoadGR(p, c, RAX, reg2);
+
+               if(op6 == DIV)
+               {
+                  uint8 *skip;
+
+                  AluRI(p, false, ALU_CMP, RCX, 0xFFFFFFFF);
+                  skip = Jcc8(p, CC_NE);
+                  AluRI(p, false, ALU_CMP, RAX, 0x80000000);
+                  special = Jcc(p, CC_E);
+                  Patch8(skip, p);
+                  Put8(p, 0x99);					/* cdq */
+                  InsR(p, false, 0xF7, 7, RCX);			/* idiv ecx */
+               }
+               else
+               {
+                  InsR(p, false, 0x31, RDX, RDX);
+                  InsR(p, false, 0xF7, 6, RCX);			/* div ecx */
+               }
+               StoreGR(p, c, 30, RDX);
+               StoreGR(p, c, reg2, RAX);
+               InsR(p, false, 0x89, RAX, RCX);
+               InsR(p, false, 0x85, RCX, RCX);
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV, OV_X86, CY_X86);
+
+               if(special)
+               {
+                  done = Jmp(p);
+                  Patch(special, p);
+                  StoreMI(p, GR(c, 30), 0);
+                  StoreMI(p, GR(c, reg2), 0x80000000);
+                  InsM(p, false, 0x8B, RAX, RBX, -1, 1, c.psw);
+                  AluRI(p, false, ALU_AND, RAX, ~(PSW_Z | PSW_S | PSW_OV));
+                  AluRI(p, false, ALU_OR, RAX, PSW_S | PSW_OV);
+                  InsM(p, false, 0x89, RAX, RBX, -1, 1, c.psw);
+                  Patch(done, p);
+               }
+               AddClock(c, (op6 == DIV) ? 38 : 36);
+               new_lo = -1;
+               writes_r0 = !reg2;
+            }
+            break;
+
+            case MOV_I:
+               StoreMI(p, GR(c, reg2), sign_5(reg1));
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case ADD_I:
+            case CMP_I:
+               LoadGR(p, c, RCX, reg2);
+               AluRI(p, false, (op6 == ADD_I) ? ALU_ADD : ALU_CMP, RCX, sign_5(reg1));
+               if(op6 == ADD_I)
+               {
+                  StoreGR(p, c, reg2, RCX);
+                  writes_r0 = !reg2;
+               }
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV | PSW_CY, OV_X86, CY_X86);
+               AddClock(c, 1);
+               break;
+
+            case SETF:
+               if((reg1 & 0xF) == COND_T || (reg1 & 0xF) == COND_F)
+                  StoreMI(p, GR(c, reg2), (reg1 & 0xF) == COND_T);
+               else
+               {
+                  const unsigned cc = EmitCond(p, c, reg1 & 0xF);
+
+                  InsR(p, false, 0x0F90 | cc, 0, RCX, true);	/* setcc cl */
+                  InsR(p, false, 0x0FB6, RCX, RCX, true);	/* movzx ecx, cl */
+                  StoreGR(p, c, reg2, RCX);
+               }
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case STSR:
+               InsM(p, false, 0x8B, RCX, RBX, -1, 1, c.sreg + reg1 * 4);
+               StoreGR(p, c, reg2, RCX);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case MOVEA:
+            case MOVHI:
+            case ADDI:
+               LoadGR(p, c, RCX, reg1);
+               AluRI(p, false, ALU_ADD, RCX, (op6 == MOVHI) ? (uint32)ext << 16 : sign_16(ext));
+               StoreGR(p, c, reg2, RCX);
+               if(op6 == ADDI)
+                  EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV | PSW_CY, OV_X86, CY_X86);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case ORI:
+            case ANDI:
+            case XORI:
+               LoadGR(p, c, RCX, reg1);
+               AluRI(p, false, (op6 == ORI) ? ALU_OR : (op6 == ANDI) ? ALU_AND : ALU_XOR, RCX, ext);
+               StoreGR(p, c, reg2, RCX);
+               EmitFlags(p, c, PSW_Z | PSW_S | PSW_OV, OV_X86, CY_X86);
+               AddClock(c, 1);
+               writes_r0 = !reg2;
+               break;
+
+            case LD_B:
+            case LD_H:
+            case LD_W:
+            {
+               const uint32 align = (op6 == LD_B) ? 0xFFFFFFFF : (op6 == LD_H) ? 0xFFFFFFFE : 0xFFFFFFFC;
+               const uint32 penalty = (op6 == LD_W) ? 2 : 0;	/* Two 16-bit bus cycles */
+               JITSlowLoad *s = &c.slow[c.slow_count++];
+               JITSlowLoad *s_bus32 = NULL;
+
+               /* The helpers see the timestamp before this instruction. */
+               s->clocks = c.clocks;
+
+               /* eax = address, rdx = host pointer */
+               LoadGR(p, c, RAX, reg1);
+               if(ext)
+                  AluRI(p, false, ALU_ADD, RAX, sign_16(ext));
+               if(align != 0xFFFFFFFF)
+                  AluRI(p, false, ALU_AND, RAX, align);
+               EmitMapPage(p, c.datamap);
+
+               /* Anything not in the data map goes through MemRead*() */
+               InsR(p, true, 0x85, RDX, RDX);				/* test rdx, rdx */
+               s->rel = Jcc(p, CC_E);
+               InsR(p, false, 0x0FB7, RCX, RAX);			/* movzx ecx, ax */
+               InsR(p, true, 0x01, RCX, RDX);				/* add rdx, rcx */
+
+               if(op6 == LD_W)
+               {
+                  /* 32-bit bus accesses take the helper path too. */
+                  InsR(p, false, 0x89, RAX, RCX);
+                  ShiftRI(p, false, SH_SHR, RCX, 24);
+                  InsM(p, false, 0x80, 7, RBX, RCX, 1, c.bus32);	/* cmp byte [MemReadBus32 + ecx], 0 */
+                  Put8(p, 0);
+                  s_bus32 = &c.slow[c.slow_count++];
+                  s_bus32->rel = Jcc(p, CC_NE);
+                  InsM(p, false, 0x8B, RCX, RDX, -1, 1, 0);		/* mov ecx, [rdx] */
+               }
+               else
+                  InsM(p, false, (op6 == LD_B) ? 0x0FBE : 0x0FBF, RCX, RDX, -1, 1, 0);	/* movsx ecx, byte/word [rdx] */
+
+               StoreGR(p, c, reg2, RCX);
+
+               /* The slow path resumes past this, having added the cycles itself. */
+               if(lo_known)
+               {
+                  AddClock(c, 1 + ((lo < 0) ? 0 : (lo == LASTOP_LD) ? 1 + penalty : 2 + penalty));
+                  FlushClocks(p, c);
+               }
+               else
+               {
+                  uint8 *skip0, *skip1;
+
+                  FlushClocks(p, c);
+
+                  InsM(p, false, 0x8B, RAX, RBX, -1, 1, c.lastop);
+                  MovRI(p, RDX, 1);
+                  InsR(p, false, 0x85, RAX, RAX);
+                  skip0 = Jcc8(p, CC_S);
+                  MovRI(p, RDX, 3 + penalty);
+                  AluRI(p, false, ALU_CMP, RAX, LASTOP_LD);
+                  skip1 = Jcc8(p, CC_NE);
+                  MovRI(p, RDX, 2 + penalty);
+                  Patch8(skip0, p);
+                  Patch8(skip1, p);
+                  InsR(p, false, 0x01, RDX, R12);			/* add r12d, edx */
+               }
+
+               s->helper   = (op6 == LD_B) ? (const void *)JIT_LD_B : (op6 == LD_H) ? (const void *)JIT_LD_H : (const void *)JIT_LD_W;
+               s->reg      = reg2;
+               s->lo_store = !lo_mem;
+               s->lo       = lo;
+               s->next_ptr = next;
+               s->resume   = p;
+               if(s_bus32)
+               {
+                  uint8 *const rel = s_bus32->rel;
+
+                  *s_bus32 = *s;
+                  s_bus32->rel = rel;
+               }
+
+               new_lo = LASTOP_LD;
+               writes_r0 = !reg2;
+            }
+            break;
+
+            case ST_B:
+            case ST_H:
+            case ST_W:
+            {
+               const uint32 align = (op6 == ST_B) ? 0xFFFFFFFF : (op6 == ST_H) ? 0xFFFFFFFE : 0xFFFFFFFC;
+
+               LoadGR(p, c, RSI, reg1);
+               if(ext)
+                  AluRI(p, false, ALU_ADD, RSI, sign_16(ext));
+               if(align != 0xFFFFFFFF)
+                  AluRI(p, false, ALU_AND, RSI, align);
+               LoadGR(p, c, RDX, reg2);
+               if(!lo_mem)
+                  StoreMI(p, c.lastop, lo);
+               FlushClocks(p, c);
+               EmitCallHelper(p, c, (op6 == ST_B) ? (const void *)JIT_ST_B : (op6 == ST_H) ? (const void *)JIT_ST_H : (const void *)JIT_ST_W);
+               InsR(p, false, 0x85, RAX, RAX);
+               AddExit(c, Jcc(p, CC_NE), next, PC_base, false, LASTOP_ST);
+               lo_known = true;
+               lo_mem = true;
+               lo = LASTOP_ST;
+               count++;
+               ip = next;
+               continue;
+            }
+
+            case JMP:
+               AddClock(c, 3);
+               LoadGR(p, c, RAX, reg1);
+               AluRI(p, false, ALU_AND, RAX, 0xFFFFFFFE);
+               EmitMapPage(p, c.fastmap);
+               InsR(p, false, 0x0FB7, RCX, RAX);			/* movzx ecx, ax */
+               InsR(p, true, 0x01, RCX, RDX);
+               InsM(p, true, 0x89, RDX, RBX, -1, 1, c.pc_ptr);
+               InsR(p, true, 0x29, RAX, RDX);				/* sub rdx, rax */
+               InsM(p, true, 0x89, RDX, RBX, -1, 1, c.pc_base);
+               StoreMI(p, c.lastop, op7);
+               FlushClocks(p, c);
+               EmitJumpLookup(p, c);
+               ended = true;
+               break;
+
+            case JR:
+            case JAL:
+            case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
+            {
+               const unsigned cond = op7 & 0xF;
+               const uint32 clocks = c.clocks;
+               uint32 target;
+               uint8 *not_taken = NULL;
+               uint8 *t_ptr, *t_base;
+
+               if(op6 < 0x28 && cond == COND_F)	/* NOP */
+               {
+                  AddClock(c, 1);
+                  break;
+               }
+
+               if(op6 >= 0x28)
+               {
+                  target = pc + (sign_26(((tmpop & 0x3FF) << 16) | ext) & 0xFFFFFFFE);
+                  if(op6 == JAL)
+                     StoreMI(p, GR(c, 31), pc + 4);
+               }
+               else
+               {
+                  target = pc + (sign_9(tmpop & 0x1FE) & 0xFFFFFFFE);
+                  if(cond != COND_T)
+                     not_taken = Jcc(p, EmitCond(p, c, cond) ^ 1);
+               }
+
+               t_ptr  = FastMapPtr(target);
+               t_base = t_ptr - target;
+
+               AddClock(c, 3);
+               if(IdleLoopSkip && op6 < 0x28 && target <= pc && IsIdleLoop(target, pc))
+               {
+                  /* Same as the interpreter: fast-forward to the next event. */
+                  uint8 *skip;
+
+                  FlushClocks(p, c);
+                  InsM(p, false, 0x3B, R12, RBX, -1, 1, c.next_event_ts);
+                  skip = Jcc8(p, CC_GE);
+                  InsM(p, false, 0x8B, R12, RBX, -1, 1, c.next_event_ts);
+                  Patch8(skip, p);
+               }
+
+               if(t_ptr == PC_ptr && t_base == PC_base)
+               {
+                  /* Loop back to the start of this block. */
+                  FlushClocks(p, c);
+                  StoreMI(p, c.lastop, op7);
+                  Patch(Jmp(p), code);
+               }
+               else
+                  EmitChainExit(p, c, t_ptr, t_base, true, op7, false);
+
+               if(not_taken)
+               {
+                  Patch(not_taken, p);
+                  c.clocks = clocks;
+                  AddClock(c, 1);
+                  EmitChainExit(p, c, next, PC_base, true, op7, false);
+               }
+               ended = true;
+            }
+            break;
+         }
+
+         count++;
+         ip = next;
+
+         if(ended)
+            break;
+
+         if(writes_r0)
+            r0_dirty = true;
+
+         lo_known = true;
+         lo_mem = false;
+         lo = new_lo;
+      }
+
+      /* Out-of-line paths; all cycles up to them have been added already. */
+      c.clocks = 0;
+      for(unsigned int i = 0; i < c.slow_count; i++)
+      {
+         JITSlowLoad *s = &c.slow[i];
+
+         Patch(s->rel, p);
+         if(s->lo_store)
+            StoreMI(p, c.lastop, s->lo);
+         if(s->clocks)
+            AluRI(p, false, ALU_ADD, R12, s->clocks);
+         InsR(p, false, 0x89, RAX, RSI);		/* mov esi, eax */
+         MovRI(p, RDX, s->reg);
+         EmitCallHelper(p, c, s->helper);
+         InsR(p, false, 0x85, RAX, RAX);
+         AddExit(c, Jcc(p, CC_NE), s->next_ptr, PC_base, false, LASTOP_LD);
+         Patch(Jmp(p), s->resume);
+      }
+
+      for(unsigned int i = 0; i < c.exit_count; i++)
+      {
+         JITExit *e = &c.exits[i];
+
+         Patch(e->rel, p);
+         c.clocks = e->clocks;
+         EmitExit(p, c, e->pc_ptr, e->pc_base, e->lo_store, e->lo);
+      }
+
+      EmitExitTails(p, c);
+
+      b->code = code;
+      J->ptr = (uint8 *)(((uintptr_t)p + 15) & ~(uintptr_t)15);
+   }
+
+   return b;
+}
+
+#else
+
+bool V810::JIT_Init(void)
+{
+   return false;
+}
+
+void V810::JIT_Kill(void)
+{
+}
+
+void V810::JIT_Flush(void)
+{
+}
+
+void V810::JIT_Invalidate(const uint8 *ptr)
+{
+}
+
+void V810::JIT_CountGranule(unsigned int r, uint32 g, int32 delta)
+{
+}
+
+bool V810::JIT_Exec(v810_timestamp_t &timestamp)
+{
+   return false;
+}
+
+#endif
@@ -27,6 +27,10 @@ bool setting_vb_right_analog_to_digital=false;
 bool setting_vb_right_invert_x=false;
 bool setting_vb_right_invert_y=false;
 uint32_t setting_vb_cpu_emulation=0;
+bool setting_vb_idle_loop_skip=false;
+bool setting_vb_fpu_host=true;
+bool setting_vb_threaded_drawing=false;
+bool setting_vb_split_eye_drawing=false;
 uint32_t setting_vb_3dmode=0;
 uint32_t setting_vb_liprescale=1;
 uint32_t setting_vb_default_color=0xFFFFFF;
@@ -64,5 +68,13 @@ bool MDFN_GetSettingB(const char *name)
       return 1;
    if (!strcmp("vb.allow_draw_skip", name))
       return 1;
+   if (!strcmp("vb.idle_loop_skip", name))
+      return setting_vb_idle_loop_skip;
+   if (!strcmp("vb.fpu_host", name))
+      return setting_vb_fpu_host;
+   if (!strcmp("vb.threaded_drawing", name))
+      return setting_vb_threaded_drawing;
+   if (!strcmp("vb.split_eye_drawing", name))
+      return setting_vb_split_eye_drawing;
    return 0;
 }
@@ -17,6 +17,10 @@ extern bool setting_vb_right_analog_to_digital;
 extern bool setting_vb_right_invert_x;
 extern bool setting_vb_right_invert_y;
 extern uint32_t setting_vb_cpu_emulation;
+extern bool setting_vb_idle_loop_skip;
+extern bool setting_vb_fpu_host;
+extern bool setting_vb_threaded_drawing;
+extern bool setting_vb_split_eye_drawing;
 extern uint32_t setting_vb_3dmode;
 extern uint32_t setting_vb_liprescale;
 extern uint32_t setting_vb_default_color;
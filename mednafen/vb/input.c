@@ -137,7 +137,7 @@ void VBINPUT_Frame(void)
    PadData = (MDFN_de16lsb(data_ptr[0]) << 2) | 0x2 | (*data_ptr[1] & 0x1);
 }
 
-v810_timestamp_t VBINPUT_Update(const v810_timestamp_t timestamp)
+v810_timestamp_t MDFN_FASTCALL VBINPUT_Update(const v810_timestamp_t timestamp)
 {
    int32 clocks = timestamp - last_ts;
 
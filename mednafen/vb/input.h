@@ -21,7 +21,7 @@ void VBINPUT_Write(v810_timestamp_t timestamp, uint32 A, uint8 V);
 void VBINPUT_Frame(void);
 int VBINPUT_StateAction(StateMem *sm, int load, int data_only);
 
-int32 VBINPUT_Update(const int32 timestamp);
+v810_timestamp_t MDFN_FASTCALL VBINPUT_Update(const v810_timestamp_t timestamp);
 void VBINPUT_ResetTS(void);
 
 void VBINPUT_Power(void);
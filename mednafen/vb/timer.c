@@ -34,7 +34,7 @@ static v810_timestamp_t TimerLastTS;
 static bool TimerStatus, TimerStatusShadow;
 static bool ReloadPending;
 
-v810_timestamp_t TIMER_Update(v810_timestamp_t timestamp)
+v810_timestamp_t MDFN_FASTCALL TIMER_Update(const v810_timestamp_t timestamp)
 {
    int32 run_time = timestamp - TimerLastTS;
 
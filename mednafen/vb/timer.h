@@ -15,7 +15,7 @@ enum
    TIMER_GSREG_COUNTER
 };
 
-v810_timestamp_t TIMER_Update(v810_timestamp_t timestamp);
+v810_timestamp_t MDFN_FASTCALL TIMER_Update(const v810_timestamp_t timestamp);
 
 void TIMER_ResetTS(void);
 
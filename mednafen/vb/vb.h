@@ -21,6 +21,8 @@ enum
 // VB_EVENT_COMM
 };
 
+#define VB_EVENT_MAX          8	/* Room for more event types(see VB_RegisterEvent()); at most 32, for EventHandler() */
+
 #define VB_MASTER_CLOCK       20000000.0
 
 #define VB_EVENT_NONONO       0x7fffffff
@@ -37,6 +39,13 @@ enum
 extern "C" {
 #endif
 
+/* Brings a device up to timestamp when its event is due, and returns the new deadline
+ * (VB_EVENT_NONONO for none). */
+typedef v810_timestamp_t (MDFN_FASTCALL *VB_EventHandler)(const v810_timestamp_t timestamp);
+
+/* Makes the scheduler call handler for events of this type; the deadline starts out as
+ * VB_EVENT_NONONO.  Deadlines are changed with VB_SetEvent(), or by handler's return value. */
+void VB_RegisterEvent(const int type, VB_EventHandler handler);
 void VB_SetEvent(const int type, const v810_timestamp_t next_timestamp);
 
 void VBIRQ_Assert(int source, bool assert);
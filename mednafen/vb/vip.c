@@ -15,8 +15,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <stdlib.h>
 #include <math.h>
 
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#include <libretro.h>
 #include <retro_inline.h>
 
 #include "vb.h"
@@ -26,9 +32,121 @@
 #include "../masmem.h"
 #include "../state_helpers.h"
 
-static uint8 FB[2][2][0x6000];
-static uint16 CHR_RAM[0x8000 / sizeof(uint16)];
-static uint16 DRAM[0x20000 / sizeof(uint16)];
+/* VRAM laid out as the CPU sees it at 0x00000-0x3FFFF, so it can be mapped straight into the CPU's
+ * address space(see VIP_GetVRAM()): the four frame buffers, each followed by a quarter of CHR RAM,
+ * then DRAM(BG maps, parameter tables, world attributes and OAM). */
+static uint16 VRAM[VIP_VRAM_SIZE / sizeof(uint16)];
+static uint16 *const DRAM = &VRAM[0x20000 / sizeof(uint16)];
+
+/* Set by CPU writes(directly and through VIP_Write8/16()), one per (1 << VIP_VRAM_DIRTY_SHIFT) bytes
+ * of VRAM; only cleared by whoever consumes them. */
+static uint8 VRAM_Dirty[VIP_VRAM_SIZE >> VIP_VRAM_DIRTY_SHIFT];
+
+/* Frame buffer fb of the left(lr = 0) or right(lr = 1) display */
+#define FB_PTR(fb, lr) ((uint8 *)VRAM + ((lr) << 16) + ((fb) << 15))
+
+/* VRAM offset of CHR RAM byte A(0x0000-0x7FFF, as at 0x78000) */
+#define CHR_OFFSET(A) (0x6000 | (((A) & 0x6000) << 2) | ((A) & 0x1FFF))
+
+/* The 2048 characters with one byte(0-3) per pixel, as stored(hflip = 0) and mirrored(hflip = 1).
+ * Kept up to date with CHR RAM by CHR_CacheUpdate(), which consumes CHR RAM's dirty flags. */
+static MDFN_ALIGN(16) uint8 CHR_Cache[2048][2][8][8];
+
+/* Row y of character c, 8 pixels left to right */
+#define CHR_CACHE_ROW(c, hflip, y) (CHR_Cache[(c)][(hflip)][(y)])
+
+/* The same characters in the frame buffer's column layout: per column, left to right, a word of its 8
+ * pixels, 2 bits each, top row in the low bits; for hflip | (vflip << 1). Kept with CHR_Cache. */
+static MDFN_ALIGN(16) uint16 CHR_Cols[2048][4][8];
+
+/* Reverses the order of the 8 2-bit pixels of a column word */
+static INLINE uint16 CHR_ColFlip(uint16 v)
+{
+   v = (v >> 8) | (v << 8);
+   v = ((v >> 4) & 0x0F0F) | ((v & 0x0F0F) << 4);
+   v = ((v >> 2) & 0x3333) | ((v & 0x3333) << 2);
+
+   return v;
+}
+
+/* Returns which quarters(bit q for characters (q << 9) to (q << 9) + 511) had characters changed. */
+static unsigned CHR_CacheUpdate(void)
+{
+   unsigned changed = 0;
+   unsigned q, i, j;
+
+   for(q = 0; q < 4; q++)
+   {
+      uint8 *dirty = &VRAM_Dirty[CHR_OFFSET(q << 13) >> VIP_VRAM_DIRTY_SHIFT];
+
+      for(i = 0; i < 512; i += 8)
+      {
+         uint64 any;
+
+         memcpy(&any, &dirty[i], sizeof(any));
+         if(!any)
+            continue;
+
+         for(j = i; j < i + 8; j++)
+         {
+            const uint32 c = (q << 9) | j;
+            const uint16 *rows = &VRAM[CHR_OFFSET(c << 4) >> 1];
+            uint16 cols[8] = { 0 };
+            unsigned y, x;
+
+            if(!dirty[j])
+               continue;
+
+            dirty[j] = 0;
+            changed |= 1 << q;
+
+            for(y = 0; y < 8; y++)
+            {
+               for(x = 0; x < 8; x++)
+               {
+                  const uint8 pixel = (rows[y] >> (x * 2)) & 3;
+
+                  CHR_Cache[c][0][y][x] = pixel;
+                  CHR_Cache[c][1][y][7 - x] = pixel;
+                  cols[x] |= pixel << (y * 2);
+               }
+            }
+
+            for(x = 0; x < 8; x++)
+            {
+               CHR_Cols[c][0][x] = cols[x];
+               CHR_Cols[c][1][7 - x] = cols[x];
+               CHR_Cols[c][2][x] = CHR_ColFlip(cols[x]);
+               CHR_Cols[c][3][7 - x] = CHR_ColFlip(cols[x]);
+            }
+         }
+      }
+   }
+
+   return changed;
+}
+
+/* Clears the dirty flags of VRAM offsets [A, A + length), and returns true if any were set. */
+static bool VRAM_DirtyTake(uint32 A, uint32 length)
+{
+   bool any = false;
+   uint8 *dirty = &VRAM_Dirty[A >> VIP_VRAM_DIRTY_SHIFT];
+   uint32 i;
+
+   for(i = 0; i < (length >> VIP_VRAM_DIRTY_SHIFT); i += 8)
+   {
+      uint64 flags;
+
+      memcpy(&flags, &dirty[i], sizeof(flags));
+      if(flags)
+      {
+         memset(&dirty[i], 0, sizeof(flags));
+         any = true;
+      }
+   }
+
+   return any;
+}
 
 /* Helper functions for the V810 VIP RAM read/write handlers.
  *  "Memory Array 16 (Write/Read) (16/8)" */
@@ -84,6 +202,12 @@ static void CopyFBColumnToTarget_SideBySide(void) NO_INLINE;
 static void CopyFBColumnToTarget_VLI(void) NO_INLINE;
 static void CopyFBColumnToTarget_HLI(void) NO_INLINE;
 static void (*CopyFBColumnToTarget)(void) = NULL;
+static void CopyFrameRowsToTarget_Anaglyph(void) NO_INLINE;
+static void CopyFrameRowsToTarget_AnaglyphSlow(void) NO_INLINE;
+static void CopyFrameRowsToTarget_SideBySide(void) NO_INLINE;
+static void CopyFrameRowsToTarget_VLI(void) NO_INLINE;
+static void CopyFrameRowsToTarget_HLI(void) NO_INLINE;
+static void (*CopyFrameRowsToTarget)(void) = NULL;
 static uint32 VB3DMode;
 static uint32 VB3DReverse;
 static uint32 VBPrescale;
@@ -93,8 +217,23 @@ static uint32 ColorLUT[2][256];
 static int32 BrightnessCache[4];
 static uint32 BrightCLUT[2][4];
 
+static double GammaLUT[256];	/* pow(i / 255, 1 / 2.2) */
+static bool GammaLUT_Ready;
+static uint32 ColorLUT_Colors[2];	/* What each eye of ColorLUT was made for. */
+static bool ColorLUT_Ready;
+
+/* Only the anaglyph slow mode needs these, and only for the few level pairs on screen at a time, so
+ * AnaSlowColorLUT entries are made on first use; AnaSlowColorLUT_Made has a bit for each. */
 static double ColorLUTNoGC[2][256][3];
+static bool ColorLUTNoGC_Ready;
 static uint32 AnaSlowColorLUT[256][256];
+static uint8 AnaSlowColorLUT_Made[256][256 / 8];
+
+/* AnaSlowColorLUT for just the 4 levels of each eye, so that the big table isn't read for every pixel.
+ * Rebuilt only when the levels change. */
+static uint32 AnaSlowCLUT[4][4];
+static uint8 AnaSlowCLUT_Levels[2][4];
+static bool AnaSlowCLUT_Valid;
 
 /* A few settings: */
 static bool InstantDisplayHack;
@@ -105,117 +244,182 @@ static bool ParallaxDisabled;
 static uint32 Anaglyph_Colors[2];
 static uint32 Default_Color;
 
+#ifdef HAVE_THREADS
+static bool DrawJobPending;	/* A block may still be being drawn on the draw thread(see DrawFBBlockAsync()) */
+static void DrawThreadWait(void);
+#endif
+
+/* Waits for the block being drawn on the draw thread, if any; anything that could see or change what
+ * drawing reads or writes(frame buffers, CHR RAM, DRAM, the drawing registers, the caches) calls this first. */
+static INLINE void DrawThreadJoin(void)
+{
+#ifdef HAVE_THREADS
+   if(DrawJobPending)
+      DrawThreadWait();
+#endif
+}
+
 static void MakeColorLUT(void)
 {
-   unsigned lr, i, l_b, r_b;
+   unsigned lr, i;
 
-   for(lr = 0; lr < 2; lr++)
+   if(!GammaLUT_Ready)
    {
       for(i = 0; i < 256; i++)
       {
-         double prod    = (double)i / 255;
-         double r       = prod; 
-         double g       = prod; 
-         double b       = prod;
          /* TODO: Use correct gamma curve, instead of approximation. */
-         double r_prime = pow(r, 1.0 / 2.2);
-         double g_prime = pow(g, 1.0 / 2.2);
-         double b_prime = pow(b, 1.0 / 2.2);
+         GammaLUT[i] = pow((double)i / 255, 1.0 / 2.2);
+      }
+      GammaLUT_Ready = true;
+   }
 
-         switch(VB3DMode)
-         {
-            case VB3DMODE_ANAGLYPH:
-               r_prime = r_prime * ((Anaglyph_Colors[lr ^ VB3DReverse] >> 16) & 0xFF) / 255;
-               g_prime = g_prime * ((Anaglyph_Colors[lr ^ VB3DReverse] >> 8) & 0xFF) / 255;
-               b_prime = b_prime * ((Anaglyph_Colors[lr ^ VB3DReverse] >> 0) & 0xFF) / 255;
-               break;
-            default:
-               r_prime = r_prime * ((Default_Color >> 16) & 0xFF) / 255;
-               g_prime = g_prime * ((Default_Color >> 8) & 0xFF) / 255;
-               b_prime = b_prime * ((Default_Color >> 0) & 0xFF) / 255;
-               break;
-         }
-         ColorLUTNoGC[lr][i][0] = pow(r_prime, 2.2 / 1.0);
-         ColorLUTNoGC[lr][i][1] = pow(g_prime, 2.2 / 1.0);
-         ColorLUTNoGC[lr][i][2] = pow(b_prime, 2.2 / 1.0);
+   for(lr = 0; lr < 2; lr++)
+   {
+      const uint32 color = (VB3DMode == VB3DMODE_ANAGLYPH) ? Anaglyph_Colors[lr ^ VB3DReverse] : Default_Color;
+
+      if(ColorLUT_Ready && ColorLUT_Colors[lr] == color)
+         continue;
+
+      for(i = 0; i < 256; i++)
+      {
+         double r_prime = GammaLUT[i] * ((color >> 16) & 0xFF) / 255;
+         double g_prime = GammaLUT[i] * ((color >> 8) & 0xFF) / 255;
+         double b_prime = GammaLUT[i] * ((color >> 0) & 0xFF) / 255;
 
          ColorLUT[lr][i] = MAKECOLOR((int)(r_prime * 255), (int)(g_prime * 255), (int)(b_prime * 255), 0);
       }
+
+      ColorLUT_Colors[lr] = color;
+      ColorLUTNoGC_Ready  = false;
+      AnaSlowCLUT_Valid   = false;
    }
+   ColorLUT_Ready = true;
+}
+
+static void MakeColorLUTNoGC(void)
+{
+   unsigned lr, i;
 
-   /* Anaglyph slow-mode LUT calculation */
-   for(l_b = 0; l_b < 256; l_b++)
+   for(lr = 0; lr < 2; lr++)
    {
-      for(r_b = 0; r_b < 256; r_b++)
+      const uint32 color = ColorLUT_Colors[lr];
+
+      for(i = 0; i < 256; i++)
       {
-         double r_prime, g_prime, b_prime;
-         double r = ColorLUTNoGC[0][l_b][0] + ColorLUTNoGC[1][r_b][0];
-         double g = ColorLUTNoGC[0][l_b][1] + ColorLUTNoGC[1][r_b][1];
-         double b = ColorLUTNoGC[0][l_b][2] + ColorLUTNoGC[1][r_b][2];
-
-         if(r > 1.0)
-            r = 1.0;
-         if(g > 1.0)
-            g = 1.0;
-         if(b > 1.0)
-            b = 1.0;
-
-         r_prime = pow(r, 1.0 / 2.2);
-         g_prime = pow(g, 1.0 / 2.2);
-         b_prime = pow(b, 1.0 / 2.2);
-
-         AnaSlowColorLUT[l_b][r_b] = MAKECOLOR(((int)(r_prime * 255)), ((int)(g_prime * 255)), ((int)(b_prime * 255)), 0);
+         double r_prime = GammaLUT[i] * ((color >> 16) & 0xFF) / 255;
+         double g_prime = GammaLUT[i] * ((color >> 8) & 0xFF) / 255;
+         double b_prime = GammaLUT[i] * ((color >> 0) & 0xFF) / 255;
+
+         ColorLUTNoGC[lr][i][0] = pow(r_prime, 2.2 / 1.0);
+         ColorLUTNoGC[lr][i][1] = pow(g_prime, 2.2 / 1.0);
+         ColorLUTNoGC[lr][i][2] = pow(b_prime, 2.2 / 1.0);
       }
    }
+
+   memset(AnaSlowColorLUT_Made, 0, sizeof(AnaSlowColorLUT_Made));
+   ColorLUTNoGC_Ready = true;
 }
 
-static void RecalcBrightnessCache(void)
+/* Anaglyph slow-mode color for left and right brightness l_b and r_b */
+static uint32 AnaSlowColor(unsigned l_b, unsigned r_b)
 {
-   unsigned i, lr;
-   int32 CumulativeTime = (BRTA + 1 + BRTB + 1 + BRTC + 1 + REST + 1) + 1;
-   int32 MaxTime = 128;
+   if(!ColorLUTNoGC_Ready)
+      MakeColorLUTNoGC();
 
-   BrightnessCache[0] = 0;
-   BrightnessCache[1] = 0;
-   BrightnessCache[2] = 0;
-   BrightnessCache[3] = 0;
-
-   for(i = 0; i < Repeat + 1; i++)
+   if(!(AnaSlowColorLUT_Made[l_b][r_b >> 3] & (1 << (r_b & 7))))
    {
-      int32 btemp[4];
+      double r_prime, g_prime, b_prime;
+      double r = ColorLUTNoGC[0][l_b][0] + ColorLUTNoGC[1][r_b][0];
+      double g = ColorLUTNoGC[0][l_b][1] + ColorLUTNoGC[1][r_b][1];
+      double b = ColorLUTNoGC[0][l_b][2] + ColorLUTNoGC[1][r_b][2];
+
+      if(r > 1.0)
+         r = 1.0;
+      if(g > 1.0)
+         g = 1.0;
+      if(b > 1.0)
+         b = 1.0;
+
+      r_prime = pow(r, 1.0 / 2.2);
+      g_prime = pow(g, 1.0 / 2.2);
+      b_prime = pow(b, 1.0 / 2.2);
+
+      AnaSlowColorLUT[l_b][r_b] = MAKECOLOR(((int)(r_prime * 255)), ((int)(g_prime * 255)), ((int)(b_prime * 255)), 0);
+      AnaSlowColorLUT_Made[l_b][r_b >> 3] |= 1 << (r_b & 7);
+   }
 
-      if((i * CumulativeTime) >= MaxTime)
-         break;
+   return AnaSlowColorLUT[l_b][r_b];
+}
 
-      btemp[1] = (i * CumulativeTime) + BRTA;
-      if(btemp[1] > MaxTime)
-         btemp[1] = MaxTime;
-      btemp[1] -= (i * CumulativeTime);
-      if(btemp[1] < 0)
-         btemp[1] = 0;
+/* BrightnessCache for each Repeat value, made for the BRTA/BRTB/BRTC/REST values in brt. */
+typedef struct
+{
+   uint32 brt;
+   bool valid;
+   int32 levels[4];
+} BrightnessMemoEntry;
 
+static BrightnessMemoEntry BrightnessMemo[256];
 
-      btemp[2] = (i * CumulativeTime) + BRTA + 1 + BRTB;
-      if(btemp[2] > MaxTime)
-         btemp[2] = MaxTime;
-      btemp[2] -= (i * CumulativeTime) + BRTA + 1;
-      if(btemp[2] < 0)
-         btemp[2] = 0;
+static void RecalcBrightnessCache(void)
+{
+   unsigned i, lr;
+   BrightnessMemoEntry *memo = &BrightnessMemo[Repeat];
+   const uint32 brt = BRTA | (BRTB << 8) | (BRTC << 16) | ((uint32)REST << 24);
 
-      btemp[3] = (i * CumulativeTime) + BRTA + BRTB + BRTC + 1;
-      if(btemp[3] > MaxTime)
-         btemp[3] = MaxTime;
-      btemp[3] -= (i * CumulativeTime) + 1;
-      if(btemp[3] < 0)
-         btemp[3] = 0;
+   if(memo->valid && memo->brt == brt)
+      memcpy(BrightnessCache, memo->levels, sizeof(BrightnessCache));
+   else
+   {
+      int32 CumulativeTime = (BRTA + 1 + BRTB + 1 + BRTC + 1 + REST + 1) + 1;
+      int32 MaxTime = 128;
 
-      BrightnessCache[1] += btemp[1];
-      BrightnessCache[2] += btemp[2];
-      BrightnessCache[3] += btemp[3];
-   }
+      BrightnessCache[0] = 0;
+      BrightnessCache[1] = 0;
+      BrightnessCache[2] = 0;
+      BrightnessCache[3] = 0;
 
-   for(i = 0; i < 4; i++)
-      BrightnessCache[i] = 255 * BrightnessCache[i] / MaxTime;
+      for(i = 0; i < Repeat + 1; i++)
+      {
+         int32 btemp[4];
+
+         if((i * CumulativeTime) >= MaxTime)
+            break;
+
+         btemp[1] = (i * CumulativeTime) + BRTA;
+         if(btemp[1] > MaxTime)
+            btemp[1] = MaxTime;
+         btemp[1] -= (i * CumulativeTime);
+         if(btemp[1] < 0)
+            btemp[1] = 0;
+
+
+         btemp[2] = (i * CumulativeTime) + BRTA + 1 + BRTB;
+         if(btemp[2] > MaxTime)
+            btemp[2] = MaxTime;
+         btemp[2] -= (i * CumulativeTime) + BRTA + 1;
+         if(btemp[2] < 0)
+            btemp[2] = 0;
+
+         btemp[3] = (i * CumulativeTime) + BRTA + BRTB + BRTC + 1;
+         if(btemp[3] > MaxTime)
+            btemp[3] = MaxTime;
+         btemp[3] -= (i * CumulativeTime) + 1;
+         if(btemp[3] < 0)
+            btemp[3] = 0;
+
+         BrightnessCache[1] += btemp[1];
+         BrightnessCache[2] += btemp[2];
+         BrightnessCache[3] += btemp[3];
+      }
+
+      for(i = 0; i < 4; i++)
+         BrightnessCache[i] = 255 * BrightnessCache[i] / MaxTime;
+
+      memcpy(memo->levels, BrightnessCache, sizeof(memo->levels));
+      memo->brt   = brt;
+      memo->valid = true;
+   }
 
    for(lr = 0; lr < 2; lr++)
       for(i = 0; i < 4; i++)
@@ -228,27 +432,36 @@ static void Recalc3DModeStuff(bool non_rgb_output)
    {
       default: 
          CopyFBColumnToTarget = CopyFBColumnToTarget_Anaglyph;
+         CopyFrameRowsToTarget = CopyFrameRowsToTarget_Anaglyph;
          if(((Anaglyph_Colors[0] & 0xFF) && (Anaglyph_Colors[1] & 0xFF)) ||
                ((Anaglyph_Colors[0] & 0xFF00) && (Anaglyph_Colors[1] & 0xFF00)) ||
                ((Anaglyph_Colors[0] & 0xFF0000) && (Anaglyph_Colors[1] & 0xFF0000)) ||
                non_rgb_output)
+         {
             CopyFBColumnToTarget = CopyFBColumnToTarget_AnaglyphSlow;
+            CopyFrameRowsToTarget = CopyFrameRowsToTarget_AnaglyphSlow;
+         }
          break;
 
       case VB3DMODE_CSCOPE:
+         /* Columns already go to surface rows here. */
          CopyFBColumnToTarget = CopyFBColumnToTarget_CScope;
+         CopyFrameRowsToTarget = NULL;
          break;
 
       case VB3DMODE_SIDEBYSIDE:
          CopyFBColumnToTarget = CopyFBColumnToTarget_SideBySide;
+         CopyFrameRowsToTarget = CopyFrameRowsToTarget_SideBySide;
          break;
 
       case VB3DMODE_VLI:
          CopyFBColumnToTarget = CopyFBColumnToTarget_VLI;
+         CopyFrameRowsToTarget = CopyFrameRowsToTarget_VLI;
          break;
 
       case VB3DMODE_HLI:
          CopyFBColumnToTarget = CopyFBColumnToTarget_HLI;
+         CopyFrameRowsToTarget = CopyFrameRowsToTarget_HLI;
          break;
    }
    RecalcBrightnessCache();
@@ -291,6 +504,7 @@ void VIP_Set3DMode(uint32 mode, bool reverse, uint32 prescale, uint32 sbs_separa
 
 void VIP_SetParallaxDisable(bool disabled)
 {
+   DrawThreadJoin();
    ParallaxDisabled = disabled;
 }
 
@@ -356,6 +570,7 @@ static INLINE void Recalc_JPLT_Cache(int which)
 static uint16 BKCOL;
 
 static int32 last_ts;
+static int32 NextUpdateTS;
 
 static int32 Column;
 static int32 ColumnCounter;
@@ -372,11 +587,118 @@ static uint32 DrawingBlock;
 static int32 SB_Latch;
 static int32 SBOUT_InactiveTime;
 
+/* Bumped whenever something VIP_DrawBlock() reads(DRAM, CHR RAM and the registers in DrawRegs) may
+ * have changed, as found by CheckDrawInputs(); it never goes back. What changed is stamped with the
+ * new value. */
+static uint64 DrawInputsGen;
+static uint64 DRAM_SegmentGen[16];	/* 8KiB DRAM segments, 0x20000-0x3FFFF */
+static uint64 CHR_QuarterGen[4];	/* 512 characters each */
+static uint64 DrawRegsGen;
+static uint16 DrawRegs[4 + 4 + 4 + 2];
+
+/* DrawInputsGen when each block of each frame buffer was last drawn, or 0 if what's there isn't what
+ * VIP_DrawBlock() drew; a block drawn with the current DrawInputsGen needn't be drawn again. */
+static uint64 FB_BlockGen[2][28];
+
+/* What each world looked like when last drawn in each block(see vip_draw.inc); its pixels are kept,
+ * in WorldCachePixels, once it has been seen unchanged. */
+typedef struct
+{
+   uint16 attr[11];	/* World attribute words 0-10 */
+   uint8 obj_group;	/* SPT[] entry, for OBJ worlds */
+   uint8 chr_quarters;	/* CHR_QuarterGen[] bits it read */
+   uint16 dram_segments;	/* DRAM_SegmentGen[] bits it read */
+   bool has_pixels;
+   uint64 drawn_gen;	/* DrawInputsGen when drawn, 0 if never */
+} WorldCacheEntry;
+
+/* A world's pixels in a block for one eye, in the column layout blocks are drawn in(see vip_draw.inc) */
+typedef struct
+{
+   uint16 color[384];	/* 0 where transparent */
+   uint16 clear[384];	/* 3 in each pixel's bits where transparent, 0 where not */
+} WorldPixels;
+
+static WorldCacheEntry WorldCache[28][32];
+static WorldPixels (*WorldCachePixels)[32][2] = NULL;	/* [block][world][lr] */
+
+static void ForgetDrawnBlocks(void)
+{
+   memset(FB_BlockGen, 0, sizeof(FB_BlockGen));
+   memset(WorldCache, 0, sizeof(WorldCache));
+}
+
+/* Takes in everything that changed since the last call, before drawing a block to frame buffer fb. */
+static void CheckDrawInputs(int fb)
+{
+   const uint64 gen = DrawInputsGen + 1;
+   uint16 regs[4 + 4 + 4 + 2];
+   bool changed = false;
+   unsigned chr_changed;
+   int i, lr;
+
+   memcpy(&regs[0], SPT, sizeof(SPT));
+   memcpy(&regs[4], GPLT, sizeof(GPLT));
+   memcpy(&regs[8], JPLT, sizeof(JPLT));
+   regs[12] = BKCOL;
+   regs[13] = ParallaxDisabled;
+
+   chr_changed = CHR_CacheUpdate();
+   for(i = 0; i < 4; i++)
+   {
+      if(chr_changed & (1 << i))
+      {
+         CHR_QuarterGen[i] = gen;
+         changed = true;
+      }
+   }
+
+   for(i = 0; i < 16; i++)
+   {
+      if(VRAM_DirtyTake(0x20000 + (i << 13), 0x2000))
+      {
+         DRAM_SegmentGen[i] = gen;
+         changed = true;
+      }
+   }
+
+   if(memcmp(regs, DrawRegs, sizeof(regs)))
+   {
+      memcpy(DrawRegs, regs, sizeof(regs));
+      DrawRegsGen = gen;
+      changed = true;
+   }
+
+   if(changed)
+      DrawInputsGen = gen;
+
+   /* CPU writes to the frame buffer itself. */
+   for(lr = 0; lr < 2; lr++)
+   {
+      if(VRAM_DirtyTake(((uint32)lr << 16) | ((uint32)fb << 15), 0x6000))
+         memset(FB_BlockGen[fb], 0, sizeof(FB_BlockGen[fb]));
+   }
+}
+
 static void CheckIRQ(void)
 {
    VBIRQ_Assert(VBIRQ_SOURCE_VIP, (bool)(InterruptEnable & InterruptPending));
 }
 
+static void VIP_Advance(const v810_timestamp_t timestamp);
+
+/* Brings the column counters up to timestamp on a register access, as long as that only
+ * passes over ticks VIP_NextTickClocks() skipped; anything else waits for its event. */
+static INLINE void VIP_CatchUp(const v810_timestamp_t timestamp)
+{
+   if(timestamp <= last_ts || timestamp >= NextUpdateTS)
+      return;
+
+   if(DrawingCounter > 0 && (timestamp - last_ts) >= DrawingCounter)
+      return;
+
+   VIP_Advance(timestamp);
+}
 
 bool VIP_Init(void)
 {
@@ -393,17 +715,36 @@ bool VIP_Init(void)
 
    VidSettingsDirty = true;
 
-   return(true);
+   /* Drawing works without it, just without keeping unchanged worlds(see PlanBlock()). */
+   if(!WorldCachePixels)
+      WorldCachePixels = (WorldPixels (*)[32][2])malloc(28 * sizeof(*WorldCachePixels));
+
+   return(WorldCachePixels != NULL);
+}
+
+void VIP_Kill(void)
+{
+   VIP_SetDrawThread(false);
+   VIP_SetEyeThread(false);
+
+   if(WorldCachePixels)
+   {
+      free(WorldCachePixels);
+      WorldCachePixels = NULL;
+   }
 }
 
 void VIP_Power(void)
 {
    unsigned i;
 
+   DrawThreadJoin();
+
    Repeat = 0;
    SB_Latch = 0;
    SBOUT_InactiveTime = -1;
    last_ts = 0;
+   NextUpdateTS = 0;
 
    Column = 0;
    ColumnCounter = 259;
@@ -423,9 +764,9 @@ void VIP_Power(void)
 
 
 
-   memset(FB, 0, 0x6000 * 2 * 2);
-   memset(CHR_RAM, 0, 0x8000);
-   memset(DRAM, 0, 0x20000);
+   memset(VRAM, 0, sizeof(VRAM));
+   memset(VRAM_Dirty, 1, sizeof(VRAM_Dirty));
+   ForgetDrawnBlocks();
 
    InterruptPending = 0;
    InterruptEnable = 0;
@@ -457,6 +798,8 @@ static INLINE uint16 ReadRegister(int32 timestamp, uint32 A)
 {
    uint16_t ret = 0;
 
+   VIP_CatchUp(timestamp);
+
    switch(A & 0xFE)
    {
       case 0x00:
@@ -553,6 +896,9 @@ static INLINE uint16 ReadRegister(int32 timestamp, uint32 A)
 
 static INLINE void WriteRegister(int32 timestamp, uint32 A, uint16 V)
 {
+   VIP_CatchUp(timestamp);
+   DrawThreadJoin();
+
    switch(A & 0xFE)
    {
       case 0x00:
@@ -667,12 +1013,13 @@ uint8 VIP_Read8(int32 timestamp, uint32 A)
    {
       case 0x0:
       case 0x1:
+         DrawThreadJoin();
          if((A & 0x7FFF) >= 0x6000)
-            return VIP_MA16R8(CHR_RAM, (A & 0x1FFF) | ((A >> 2) & 0x6000));
-         return FB[(A >> 15) & 1][(A >> 16) & 1][A & 0x7FFF];
+            return VIP_MA16R8(VRAM, A);
+         return ((uint8 *)VRAM)[A];
       case 0x2:
       case 0x3:
-         return VIP_MA16R8(DRAM, A & 0x1FFFF);
+         return VIP_MA16R8(VRAM, A);
       case 0x4:
       case 0x5:
          if(A >= 0x5E000)
@@ -683,7 +1030,7 @@ uint8 VIP_Read8(int32 timestamp, uint32 A)
 
       case 0x7:
          if(A >= 0x8000)
-            return VIP_MA16R8(CHR_RAM, A & 0x7FFF);
+            return VIP_MA16R8(VRAM, CHR_OFFSET(A & 0x7FFF));
          break;
       default:
          break;
@@ -698,12 +1045,13 @@ uint16 VIP_Read16(int32 timestamp, uint32 A)
    {
       case 0x0:
       case 0x1:
+         DrawThreadJoin();
          if((A & 0x7FFF) >= 0x6000)
-            return VIP_MA16R16(CHR_RAM, (A & 0x1FFF) | ((A >> 2) & 0x6000));
-         return LoadU16_LE((uint16 *)&FB[(A >> 15) & 1][(A >> 16) & 1][A & 0x7FFF]);
+            return VIP_MA16R16(VRAM, A);
+         return LoadU16_LE(&VRAM[A >> 1]);
       case 0x2:
       case 0x3:
-         return VIP_MA16R16(DRAM, A & 0x1FFFF);
+         return VIP_MA16R16(VRAM, A);
       case 0x4:
       case 0x5: 
          if(A >= 0x5E000)
@@ -713,7 +1061,7 @@ uint16 VIP_Read16(int32 timestamp, uint32 A)
          break;
       case 0x7:
          if(A >= 0x8000)
-            return VIP_MA16R16(CHR_RAM, A & 0x7FFF);
+            return VIP_MA16R16(VRAM, CHR_OFFSET(A & 0x7FFF));
          break;
       default:
          break;
@@ -724,19 +1072,23 @@ uint16 VIP_Read16(int32 timestamp, uint32 A)
 
 void VIP_Write8(int32 timestamp, uint32 A, uint8 V)
 {
+   DrawThreadJoin();
+
    switch(A >> 16)
    {
       case 0x0:
       case 0x1:
          if((A & 0x7FFF) >= 0x6000)
-            VIP_MA16W8(CHR_RAM, (A & 0x1FFF) | ((A >> 2) & 0x6000), V);
+            VIP_MA16W8(VRAM, A, V);
          else
-            FB[(A >> 15) & 1][(A >> 16) & 1][A & 0x7FFF] = V;
+            ((uint8 *)VRAM)[A] = V;
+         VRAM_Dirty[A >> VIP_VRAM_DIRTY_SHIFT] = 1;
          break;
 
       case 0x2:
       case 0x3:
-         VIP_MA16W8(DRAM, A & 0x1FFFF, V);
+         VIP_MA16W8(VRAM, A, V);
+         VRAM_Dirty[A >> VIP_VRAM_DIRTY_SHIFT] = 1;
          break;
 
       case 0x4:
@@ -750,26 +1102,33 @@ void VIP_Write8(int32 timestamp, uint32 A, uint8 V)
 
       case 0x7:
          if(A >= 0x8000)
-            VIP_MA16W8(CHR_RAM, A & 0x7FFF, V);
+         {
+            VIP_MA16W8(VRAM, CHR_OFFSET(A & 0x7FFF), V);
+            VRAM_Dirty[CHR_OFFSET(A & 0x7FFF) >> VIP_VRAM_DIRTY_SHIFT] = 1;
+         }
          break;
    }
 }
 
 void VIP_Write16(int32 timestamp, uint32 A, uint16 V)
 {
+   DrawThreadJoin();
+
    switch(A >> 16)
    {
       case 0x0:
       case 0x1:
          if((A & 0x7FFF) >= 0x6000)
-            VIP_MA16W16(CHR_RAM, (A & 0x1FFF) | ((A >> 2) & 0x6000), V);
+            VIP_MA16W16(VRAM, A, V);
          else
-            StoreU16_LE((uint16 *)&FB[(A >> 15) & 1][(A >> 16) & 1][A & 0x7FFF], V);
+            StoreU16_LE(&VRAM[A >> 1], V);
+         VRAM_Dirty[A >> VIP_VRAM_DIRTY_SHIFT] = 1;
          break;
 
       case 0x2:
       case 0x3:
-         VIP_MA16W16(DRAM, A & 0x1FFFF, V);
+         VIP_MA16W16(VRAM, A, V);
+         VRAM_Dirty[A >> VIP_VRAM_DIRTY_SHIFT] = 1;
          break;
       case 0x4:
       case 0x5:
@@ -780,7 +1139,10 @@ void VIP_Write16(int32 timestamp, uint32 A, uint16 V)
          break;
       case 0x7:
          if(A >= 0x8000)
-            VIP_MA16W16(CHR_RAM, A & 0x7FFF, V);
+         {
+            VIP_MA16W16(VRAM, CHR_OFFSET(A & 0x7FFF), V);
+            VRAM_Dirty[CHR_OFFSET(A & 0x7FFF) >> VIP_VRAM_DIRTY_SHIFT] = 1;
+         }
          break;
    }
 }
@@ -846,11 +1208,38 @@ void VIP_ResetTS(void)
 {
    if(SBOUT_InactiveTime >= 0)
       SBOUT_InactiveTime -= last_ts;
+   NextUpdateTS -= last_ts;
    last_ts = 0;
 }
 
 #include "vip_draw.inc"
 
+void VIP_SetCPUFeatures(uint64 features)
+{
+   DrawThreadJoin();
+
+   DrawCHRRow8 = DrawCHRRow8_C;
+   DrawAffine8 = NULL;
+
+#ifdef VIP_DRAW_SSE2
+   if(features & RETRO_SIMD_SSE2)
+      DrawCHRRow8 = DrawCHRRow8_SSE2;
+#ifdef VIP_DRAW_SSSE3
+   if(features & RETRO_SIMD_SSSE3)
+      DrawCHRRow8 = DrawCHRRow8_SSSE3;
+#endif
+#ifdef VIP_DRAW_AVX2
+   if(features & RETRO_SIMD_AVX2)
+      DrawAffine8 = DrawAffine8_AVX2;
+#endif
+#endif
+
+#ifdef VIP_DRAW_NEON
+   if(features & RETRO_SIMD_NEON)
+      DrawCHRRow8 = DrawCHRRow8_NEON;
+#endif
+}
+
 static INLINE void CopyFBColumnToTarget_Anaglyph_BASE(const bool DisplayActive_arg, const int lr)
 {
    int y, y_sub;
@@ -864,7 +1253,7 @@ static INLINE void CopyFBColumnToTarget_Anaglyph_BASE(const bool DisplayActive_a
    uint32 *target = surface->pixels   + Column;
 #endif
    const int32 pitchinpix = surface->pitchinpix;
-   const uint8 *fb_source = &FB[fb][lr][64 * Column];
+   const uint8 *fb_source = FB_PTR(fb, lr) + 64 * Column;
 
    if (DisplayActive_arg)
    {
@@ -942,16 +1331,31 @@ static void CopyFBColumnToTarget_Anaglyph(void)
       CopyFBColumnToTarget_Anaglyph_BASE(DisplayActive, 1);
 }
 
-static uint32 AnaSlowBuf[384][224];
+/* The left eye's pixels (0-3) and brightness levels for each column, kept until the right eye is sent. */
+static uint8 AnaSlowBuf[384][224];
+static uint8 AnaSlowLevels[384][4];
+
+static void MakeAnaSlowCLUT(uint32 *clut, const uint8 *left_levels, const uint8 *right_levels)
+{
+   unsigned l, r;
+
+   for(l = 0; l < 4; l++)
+      for(r = 0; r < 4; r++)
+         clut[l * 4 + r] = AnaSlowColor(left_levels[l], right_levels[r]);
+}
 
 static INLINE void CopyFBColumnToTarget_AnaglyphSlow_BASE(const bool DisplayActive_arg, const int lr)
 {
    const int fb = DisplayFB;
-   const uint8 *fb_source = &FB[fb][lr][64 * Column];
+   const uint8 *fb_source = FB_PTR(fb, lr) + 64 * Column;
+   unsigned i;
 
    if(!lr)
    {
-      uint32 *target = AnaSlowBuf[Column];
+      uint8 *target = AnaSlowBuf[Column];
+
+      for(i = 0; i < 4; i++)
+         AnaSlowLevels[Column][i] = BrightnessCache[i];
 
       if (DisplayActive_arg)
       {
@@ -963,8 +1367,7 @@ static INLINE void CopyFBColumnToTarget_AnaglyphSlow_BASE(const bool DisplayActi
 
             for(y_sub = 4; y_sub; y_sub--)
             {
-               uint32 pixel  = BrightnessCache[source_bits & 3];
-               *target       = pixel;
+               *target       = source_bits & 3;
                source_bits >>= 2;
                target++;
             }
@@ -972,40 +1375,36 @@ static INLINE void CopyFBColumnToTarget_AnaglyphSlow_BASE(const bool DisplayActi
          }
       }
       else
-      {
-         int y;
-         for(y = 56; y; y--)
-         {
-            int y_sub;
-
-            for(y_sub = 4; y_sub; y_sub--)
-            {
-               *target       = 0;
-               target++;
-            }
-            fb_source++;
-         }
-      }
+         memset(target, 0, 224);	/* Level 0 is always black. */
    }
    else
    {
       int y;
       uint32         *target = surface->pixels + Column;
-      const uint32 *left_src = AnaSlowBuf[Column];
+      const uint8  *left_src = AnaSlowBuf[Column];
       const int32    pitch32 = surface->pitch32;
+      uint8 right_levels[4];
+
+      for(i = 0; i < 4; i++)
+         right_levels[i] = BrightnessCache[i];
+
+      if(!AnaSlowCLUT_Valid || memcmp(AnaSlowCLUT_Levels[0], AnaSlowLevels[Column], 4) ||
+            memcmp(AnaSlowCLUT_Levels[1], right_levels, 4))
+      {
+         memcpy(AnaSlowCLUT_Levels[0], AnaSlowLevels[Column], 4);
+         memcpy(AnaSlowCLUT_Levels[1], right_levels, 4);
+         MakeAnaSlowCLUT(&AnaSlowCLUT[0][0], AnaSlowCLUT_Levels[0], AnaSlowCLUT_Levels[1]);
+         AnaSlowCLUT_Valid = true;
+      }
 
       for(y = 56; y; y--)
       {
          int y_sub;
-         uint32 source_bits = *fb_source;
+         uint32 source_bits = DisplayActive_arg ? *fb_source : 0;
 
          for(y_sub = 4; y_sub; y_sub--)
          {
-            uint32 pixel  = AnaSlowColorLUT
-               [*left_src]
-               [DisplayActive_arg ? BrightnessCache[source_bits & 3] : 0];
-
-            *target       = pixel;
+            *target       = AnaSlowCLUT[*left_src][source_bits & 3];
 
             source_bits >>= 2;
             target       += pitch32;
@@ -1030,7 +1429,7 @@ static void CopyFBColumnToTarget_CScope_BASE(const bool DisplayActive_arg, const
 {
    int y, y_sub;
    const int fb = DisplayFB;
-   const uint8 *fb_source = &FB[fb][lr][64 * Column];
+   const uint8 *fb_source = FB_PTR(fb, lr) + 64 * Column;
 
    if(dest_lr)
    {
@@ -1112,7 +1511,7 @@ static void CopyFBColumnToTarget_SideBySide_BASE(const bool DisplayActive_arg, c
    const int fb = DisplayFB;
    uint32 *target = surface->pixels + Column + (dest_lr ? (384 + VBSBS_Separation) : 0);
    const int32 pitch32 = surface->pitch32;
-   const uint8 *fb_source = &FB[fb][lr][64 * Column];
+   const uint8 *fb_source = FB_PTR(fb, lr) + 64 * Column;
 
    if(DisplayActive_arg)
    {
@@ -1163,7 +1562,7 @@ static INLINE void CopyFBColumnToTarget_VLI_BASE(const bool DisplayActive_arg, c
    const int fb           = DisplayFB;
    uint32 *target         = surface->pixels + Column * 2 * VBPrescale + dest_lr;
    const int32 pitch32    = surface->pitch32;
-   const uint8 *fb_source = &FB[fb][lr][64 * Column];
+   const uint8 *fb_source = FB_PTR(fb, lr) + 64 * Column;
 
    if(DisplayActive_arg)
    {
@@ -1222,7 +1621,7 @@ static INLINE void CopyFBColumnToTarget_HLI_BASE(const bool DisplayActive_arg, c
    const int fb = DisplayFB;
    const int32 pitch32 = surface->pitch32;
    uint32 *target = surface->pixels + Column + dest_lr * pitch32;
-   const uint8 *fb_source = &FB[fb][lr][64 * Column];
+   const uint8 *fb_source = FB_PTR(fb, lr) + 64 * Column;
 
    if(VBPrescale <= 4)
    {
@@ -1283,10 +1682,427 @@ static void CopyFBColumnToTarget_HLI(void)
       CopyFBColumnToTarget_HLI_BASE(DisplayActive, 1, 1 ^ VB3DReverse);
 }
 
-v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp)
+/* With InstantDisplayHack, the whole frame is sent to the surface at once, so rather than a column at a
+ * time (a new cache line for every pixel), LoadFrameRows() spreads both eyes of FB[DisplayFB] out to a
+ * byte per pixel in row order, along with the colors each 4 columns would have gotten from the column
+ * table, and CopyFrameRowsToTarget() then writes the surface a row at a time. */
+static uint8 FrameRows[2][224][384];
+static uint32 FrameCLUT[2][384 / 4][2][4];	/* BrightCLUT, per eye and 4 columns */
+static uint8 FrameBrightness[2][384 / 4][4];	/* BrightnessCache, likewise */
+static uint32 FrameAnaSlowCLUT[384 / 4][4 * 4];
+
+static void LoadFrameRows(void)
+{
+   int lr, x, b, i;
+
+   for(lr = 0; lr < 2; lr++)
+   {
+      const uint8 *fb_source = FB_PTR(DisplayFB, lr);
+
+      /* 8 columns at a time, each byte of a word holding one; the masks keep each shifted pixel in its
+       * own column. */
+      for(x = 0; x < 384; x += 8)
+      {
+         for(b = 0; b < 56; b++)
+         {
+            uint8 column_bytes[8];
+            uint64 source_bits;
+
+            for(i = 0; i < 8; i++)
+               column_bytes[i] = fb_source[64 * (x + i) + b];
+            memcpy(&source_bits, column_bytes, sizeof(source_bits));
+
+            for(i = 0; i < 4; i++)
+            {
+               const uint64 row = (source_bits >> (i * 2)) & 0x0303030303030303ULL;
+               memcpy(&FrameRows[lr][b * 4 + i][x], &row, sizeof(row));
+            }
+         }
+      }
+
+      for(x = 0; x < 384 / 4; x++)
+      {
+         uint16 ctdata = VIP_MA16R16(DRAM, 0x1DFFE - (x * 2) - (lr ? 0 : 0x200));
+
+         if((ctdata >> 8) != Repeat)
+         {
+            Repeat = ctdata >> 8;
+            RecalcBrightnessCache();
+         }
+
+         for(i = 0; i < 4; i++)
+         {
+            FrameCLUT[lr][x][0][i] = DisplayActive ? BrightCLUT[0][i] : 0;
+            FrameCLUT[lr][x][1][i] = DisplayActive ? BrightCLUT[1][i] : 0;
+            FrameBrightness[lr][x][i] = DisplayActive ? BrightnessCache[i] : 0;
+         }
+      }
+   }
+}
+
+static void CopyFrameRowsToTarget_Anaglyph(void)
+{
+   int y, x;
+   const int32 pitchinpix = surface->pitchinpix;
+
+   for(y = 0; y < 224; y++)
+   {
+#if defined(WANT_8BPP)
+      uint8  *target = surface->pixels8  + y * pitchinpix;
+#elif defined(WANT_16BPP)
+      uint16 *target = surface->pixels16 + y * pitchinpix;
+#else
+      uint32 *target = surface->pixels   + y * pitchinpix;
+#endif
+      const uint8 *left  = FrameRows[0][y];
+      const uint8 *right = FrameRows[1][y];
+
+      for(x = 0; x < 384; x++)
+         target[x] = FrameCLUT[0][x >> 2][0][left[x]] | FrameCLUT[1][x >> 2][1][right[x]];
+   }
+}
+
+static void CopyFrameRowsToTarget_AnaglyphSlow(void)
+{
+   int y, x;
+   const int32 pitch32 = surface->pitch32;
+
+   for(x = 0; x < 384 / 4; x++)
+      MakeAnaSlowCLUT(FrameAnaSlowCLUT[x], FrameBrightness[0][x], FrameBrightness[1][x]);
+
+   for(y = 0; y < 224; y++)
+   {
+      uint32 *target     = surface->pixels + y * pitch32;
+      const uint8 *left  = FrameRows[0][y];
+      const uint8 *right = FrameRows[1][y];
+
+      for(x = 0; x < 384; x++)
+         target[x] = FrameAnaSlowCLUT[x >> 2][left[x] * 4 + right[x]];
+   }
+}
+
+static void CopyFrameRowsToTarget_SideBySide(void)
+{
+   int lr, y, x;
+   const int32 pitch32 = surface->pitch32;
+
+   for(lr = 0; lr < 2; lr++)
+   {
+      const int dest_lr = lr ^ VB3DReverse;
+
+      for(y = 0; y < 224; y++)
+      {
+         uint32 *target       = surface->pixels + y * pitch32 + (dest_lr ? (384 + VBSBS_Separation) : 0);
+         const uint8 *source  = FrameRows[lr][y];
+
+         for(x = 0; x < 384; x++)
+            target[x] = FrameCLUT[lr][x >> 2][lr][source[x]];
+      }
+   }
+}
+
+static void CopyFrameRowsToTarget_VLI(void)
+{
+   int lr, y, x;
+   const int32 pitch32 = surface->pitch32;
+
+   for(lr = 0; lr < 2; lr++)
+   {
+      const int dest_lr = lr ^ VB3DReverse;
+
+      for(y = 0; y < 224; y++)
+      {
+         uint32 *target       = surface->pixels + y * pitch32 + dest_lr;
+         const uint8 *source  = FrameRows[lr][y];
+
+         for(x = 0; x < 384; x++)
+         {
+            uint32 ps;
+            uint32 tv = FrameCLUT[lr][x >> 2][0][source[x]];
+
+            for(ps = 0; ps < VBPrescale; ps++)
+               target[ps * 2] = tv;
+
+            target += 2 * VBPrescale;
+         }
+      }
+   }
+}
+
+static void CopyFrameRowsToTarget_HLI(void)
+{
+   int lr, y, x;
+   const int32 pitch32 = surface->pitch32;
+
+   for(lr = 0; lr < 2; lr++)
+   {
+      const int dest_lr = lr ^ VB3DReverse;
+
+      for(y = 0; y < 224; y++)
+      {
+         uint32 ps;
+         uint32 *target       = surface->pixels + ((y * VBPrescale) * 2 + dest_lr) * pitch32;
+         const uint8 *source  = FrameRows[lr][y];
+
+         for(x = 0; x < 384; x++)
+            target[x] = FrameCLUT[lr][x >> 2][0][source[x]];
+
+         for(ps = 1; ps < VBPrescale; ps++)
+            memcpy(target + ps * 2 * pitch32, target, 384 * sizeof(uint32));
+      }
+   }
+}
+
+/* Stores a block drawn by VIP_DrawBlock() in the frame buffer, which keeps each column's 2 bytes of it
+ * 64 bytes from the next column's. */
+static void StoreBlock(uint8 *FB_Target, const uint16 *cols)
+{
+   int x;
+
+   for(x = 0; x < 384; x++)
+   {
+#ifdef MSB_FIRST
+      FB_Target[64 * x + 0] = cols[x] & 0xFF;
+      FB_Target[64 * x + 1] = cols[x] >> 8;
+#else
+      memcpy(&FB_Target[64 * x], &cols[x], sizeof(cols[x]));
+#endif
+   }
+}
+
+#ifdef HAVE_THREADS
+/* A thread that runs one job at a time for another one: WorkerQueue() hands it the job's data and
+ * returns, WorkerWait() waits for the job to be done. */
+typedef struct
+{
+   bool running;
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   void (*job)(void *data);
+
+   /* Under lock */
+   void *data;
+   bool queued;	/* Cleared by the thread once the job is done */
+   bool quit;
+} VIPWorker;
+
+static void *WorkerMain(void *arg)
+{
+   VIPWorker *w = (VIPWorker *)arg;
+
+   pthread_mutex_lock(&w->lock);
+   for(;;)
+   {
+      void *data;
+
+      while(!w->queued && !w->quit)
+         pthread_cond_wait(&w->cond, &w->lock);
+
+      if(w->quit)
+         break;
+
+      data = w->data;
+      pthread_mutex_unlock(&w->lock);
+      w->job(data);
+      pthread_mutex_lock(&w->lock);
+
+      w->queued = false;
+      pthread_cond_broadcast(&w->cond);
+   }
+   pthread_mutex_unlock(&w->lock);
+
+   return NULL;
+}
+
+static void WorkerQueue(VIPWorker *w, void *data)
+{
+   pthread_mutex_lock(&w->lock);
+   w->data   = data;
+   w->queued = true;
+   pthread_cond_broadcast(&w->cond);
+   pthread_mutex_unlock(&w->lock);
+}
+
+static void WorkerWait(VIPWorker *w)
+{
+   pthread_mutex_lock(&w->lock);
+   while(w->queued)
+      pthread_cond_wait(&w->cond, &w->lock);
+   pthread_mutex_unlock(&w->lock);
+}
+
+/* Once no job is queued. */
+static void WorkerStop(VIPWorker *w)
+{
+   if(!w->running)
+      return;
+
+   pthread_mutex_lock(&w->lock);
+   w->quit = true;
+   pthread_cond_broadcast(&w->cond);
+   pthread_mutex_unlock(&w->lock);
+
+   pthread_join(w->thread, NULL);
+   pthread_cond_destroy(&w->cond);
+   pthread_mutex_destroy(&w->lock);
+   w->running = false;
+}
+
+static bool WorkerStart(VIPWorker *w, void (*job)(void *data))
+{
+   w->job    = job;
+   w->data   = NULL;
+   w->queued = false;
+   w->quit   = false;
+
+   pthread_mutex_init(&w->lock, NULL);
+   pthread_cond_init(&w->cond, NULL);
+
+   if(pthread_create(&w->thread, NULL, WorkerMain, w) == 0)
+      w->running = true;
+   else
+   {
+      pthread_cond_destroy(&w->cond);
+      pthread_mutex_destroy(&w->lock);
+   }
+
+   return w->running;
+}
+
+/* With VIP_SetEyeThread(true), DrawFBBlock() has the eye thread draw the right eye of each block
+ * while it draws the left one; PlanBlock() leaves the two nothing to share. */
+static VIPWorker EyeWorker;
+
+typedef struct
+{
+   uint8 block_no;
+   uint16 *cols;
+} EyeJob;
+
+static void EyeWorkerJob(void *data)
+{
+   const EyeJob *job = (const EyeJob *)data;
+
+   DrawBlockEye(job->block_no, 1, job->cols);
+}
+#endif
+
+/* Draws block "block" of frame buffer fb, unless nothing it depends on has changed since it was drawn. */
+static void DrawFBBlock(int fb, int block)
+{
+   MDFN_ALIGN(16) uint16 BlockCols[2][BLOCK_COLS_PAD + 384 + BLOCK_COLS_PAD];
+   int lr;
+
+   CheckDrawInputs(fb);
+
+   if(FB_BlockGen[fb][block] == DrawInputsGen)
+      return;
+
+#ifdef HAVE_THREADS
+   if(EyeWorker.running)
+   {
+      EyeJob job;
+
+      job.block_no = block;
+      job.cols     = BlockCols[1] + BLOCK_COLS_PAD;
+
+      PlanBlock(block);
+      WorkerQueue(&EyeWorker, &job);
+      DrawBlockEye(block, 0, BlockCols[0] + BLOCK_COLS_PAD);
+      WorkerWait(&EyeWorker);
+      FinishBlock(block);
+   }
+   else
+#endif
+   VIP_DrawBlock(block, BlockCols[0] + BLOCK_COLS_PAD, BlockCols[1] + BLOCK_COLS_PAD);
+
+   for(lr = 0; lr < 2; lr++)
+      StoreBlock(FB_PTR(fb, lr) + block * 2, BlockCols[lr] + BLOCK_COLS_PAD);
+
+   FB_BlockGen[fb][block] = DrawInputsGen;
+}
+
+#ifdef HAVE_THREADS
+/* With VIP_SetDrawThread(true), DrawFBBlockAsync() hands each block to the draw thread and returns, so
+ * it's drawn while the CPU runs on until something calls DrawThreadJoin(); the results are the same as
+ * drawing it right away, since nothing else touches what drawing uses in the meantime. */
+static VIPWorker DrawWorker;
+
+typedef struct
+{
+   int fb;
+   int block;
+} DrawJob;
+
+static DrawJob DrawJobArgs;
+
+static void DrawWorkerJob(void *data)
+{
+   const DrawJob *job = (const DrawJob *)data;
+
+   DrawFBBlock(job->fb, job->block);
+}
+
+static void DrawThreadWait(void)
+{
+   WorkerWait(&DrawWorker);
+   DrawJobPending = false;
+}
+#endif
+
+static void DrawFBBlockAsync(int fb, int block)
+{
+#ifdef HAVE_THREADS
+   if(DrawWorker.running)
+   {
+      DrawThreadJoin();
+
+      DrawJobArgs.fb    = fb;
+      DrawJobArgs.block = block;
+      WorkerQueue(&DrawWorker, &DrawJobArgs);
+
+      DrawJobPending = true;
+      return;
+   }
+#endif
+   DrawFBBlock(fb, block);
+}
+
+bool VIP_SetDrawThread(bool enabled)
+{
+#ifdef HAVE_THREADS
+   DrawThreadJoin();
+   WorkerStop(&DrawWorker);
+
+   if(enabled)
+      WorkerStart(&DrawWorker, DrawWorkerJob);
+
+   return DrawWorker.running;
+#else
+   return false;
+#endif
+}
+
+bool VIP_SetEyeThread(bool enabled)
+{
+#ifdef HAVE_THREADS
+   DrawThreadJoin();
+   WorkerStop(&EyeWorker);
+
+   if(enabled)
+      WorkerStart(&EyeWorker, EyeWorkerJob);
+
+   return EyeWorker.running;
+#else
+   return false;
+#endif
+}
+
+static void VIP_Advance(const v810_timestamp_t timestamp)
 {
    int32 clocks = timestamp - last_ts;
-   int32 running_timestamp = timestamp;
+   int32 running_timestamp = last_ts;
 
    while(clocks > 0)
    {
@@ -1304,34 +2120,13 @@ v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp)
          DrawingCounter -= chunk_clocks;
          if(DrawingCounter <= 0)
          {
-            MDFN_ALIGN(8) uint8 DrawingBuffers[2][512 * 8];	/* Don't decrease this from 512 unless you adjust vip_draw.inc(including areas that draw off-visible >= 384 and >= -7 for speed reasons) */
-
-            if(skip && InstantDisplayHack && AllowDrawSkip) { }
-            else
+            if(skip && InstantDisplayHack && AllowDrawSkip)
             {
-               int lr;
-               VIP_DrawBlock(DrawingBlock, DrawingBuffers[0] + 8, DrawingBuffers[1] + 8);
-
-               for(lr = 0; lr < 2; lr++)
-               {
-                  int x;
-                  uint8 *FB_Target = FB[DrawingFB][lr] + DrawingBlock * 2;
-
-                  for(x = 0; x < 384; x++)
-                  {
-                     FB_Target[64 * x + 0] = (DrawingBuffers[lr][8 + x + 512 * 0] << 0)
-                        | (DrawingBuffers[lr][8 + x + 512 * 1] << 2)
-                        | (DrawingBuffers[lr][8 + x + 512 * 2] << 4)
-                        | (DrawingBuffers[lr][8 + x + 512 * 3] << 6);
-
-                     FB_Target[64 * x + 1] = (DrawingBuffers[lr][8 + x + 512 * 4] << 0) 
-                        | (DrawingBuffers[lr][8 + x + 512 * 5] << 2)
-                        | (DrawingBuffers[lr][8 + x + 512 * 6] << 4) 
-                        | (DrawingBuffers[lr][8 + x + 512 * 7] << 6);
-
-                  }
-               }
+               DrawThreadJoin();
+               FB_BlockGen[DrawingFB][DrawingBlock] = 0;
             }
+            else
+               DrawFBBlockAsync(DrawingFB, DrawingBlock);
 
             SBOUT_InactiveTime = running_timestamp + 1120;
             SB_Latch = DrawingBlock;	/* Not exactly correct, but probably doesn't matter. */
@@ -1407,6 +2202,7 @@ v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp)
 
                   if(XPCTRL & XPCTRL_XP_EN)
                   {
+                     DrawThreadJoin();	/* For FB[DisplayFB] */
                      DisplayFB      = DrawingFB;
                      DrawingFB     ^= 1;
                      DrawingBlock   = 0;
@@ -1417,7 +2213,17 @@ v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp)
                   GameFrameCounter = 0;
                }
 
-               if(!skip && InstantDisplayHack)
+               if(!skip && InstantDisplayHack && CopyFrameRowsToTarget)
+               {
+                  uint8 save_Repeat = Repeat;
+
+                  LoadFrameRows();
+                  CopyFrameRowsToTarget();
+
+                  Repeat = save_Repeat;
+                  RecalcBrightnessCache();
+               }
+               else if(!skip && InstantDisplayHack)
                {
                   int lr;
                   /* Ugly kludge, fix in the future. */
@@ -1459,16 +2265,81 @@ v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp)
    }
 
    last_ts = timestamp;
+}
+
+/* Clocks from last_ts to the next column tick that does something the game can see.  Ticks in
+ * a displayed region output a column, unless InstantDisplayHack has the whole frame output at
+ * frame start(they then only refresh Repeat, which LoadFrameRows() redoes for every column
+ * anyway).  Otherwise only the region's last tick(interrupts, frame start) and the first tick
+ * after a drawing block finishes(the block is rendered then) matter, so the others are left for
+ * VIP_Advance() to count through. */
+static INLINE int32 VIP_NextTickClocks(void)
+{
+   int32 ret;
+
+   if((DisplayRegion & 1) && !InstantDisplayHack)
+      return ColumnCounter;
+
+   ret = ColumnCounter + (383 - Column) * 259;
+
+   if(DrawingCounter > 0)
+   {
+      int32 drawing_ret = ColumnCounter;
+
+      if(DrawingCounter > ColumnCounter)
+         drawing_ret += (DrawingCounter - ColumnCounter + 258) / 259 * 259;
+
+      if(drawing_ret < ret)
+         ret = drawing_ret;
+   }
+
+   return ret;
+}
+
+v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp)
+{
+   VIP_Advance(timestamp);
+
+   NextUpdateTS = timestamp + VIP_NextTickClocks();
 
-   return (timestamp + ColumnCounter);
+   return NextUpdateTS;
+}
+
+/* Save states keep the frame buffers and CHR RAM each in one piece, as they were before VRAM
+ * was laid out the way the CPU sees it. */
+static uint8 FB_State[2][2][0x6000];
+static uint16 CHR_State[0x8000 / sizeof(uint16)];
+
+static void VRAM_StateCopy(bool load)
+{
+   unsigned fb, lr, i;
+
+   for(fb = 0; fb < 2; fb++)
+   {
+      for(lr = 0; lr < 2; lr++)
+      {
+         if(load)
+            memcpy(FB_PTR(fb, lr), FB_State[fb][lr], 0x6000);
+         else
+            memcpy(FB_State[fb][lr], FB_PTR(fb, lr), 0x6000);
+      }
+   }
+
+   for(i = 0; i < 4; i++)
+   {
+      if(load)
+         memcpy((uint8 *)VRAM + CHR_OFFSET(i << 13), (uint8 *)CHR_State + (i << 13), 0x2000);
+      else
+         memcpy((uint8 *)CHR_State + (i << 13), (uint8 *)VRAM + CHR_OFFSET(i << 13), 0x2000);
+   }
 }
 
 int VIP_StateAction(StateMem *sm, int load, int data_only)
 {
    SFORMAT StateRegs[] =
    {
-      SFARRAY(FB[0][0], 0x6000 * 2 * 2),
-      SFARRAY16(CHR_RAM, 0x8000 / sizeof(uint16)),
+      SFARRAYN(FB_State[0][0], 0x6000 * 2 * 2, "FB[0][0]"),
+      SFARRAY16N(CHR_State, 0x8000 / sizeof(uint16), "CHR_RAM"),
       SFARRAY16(DRAM, 0x20000 / sizeof(uint16)),
 
       SFVAR(InterruptPending),
@@ -1513,11 +2384,21 @@ int VIP_StateAction(StateMem *sm, int load, int data_only)
       SFEND
    };
 
-   int ret = MDFNSS_StateAction(sm, load, data_only, StateRegs, "VIP", false);
+   int ret;
+
+   DrawThreadJoin();
+
+   /* Also on loads, so anything missing from the state is left alone. */
+   VRAM_StateCopy(false);
+
+   ret = MDFNSS_StateAction(sm, load, data_only, StateRegs, "VIP", false);
 
    if(load)
    {
       int i;
+      VRAM_StateCopy(true);
+      memset(VRAM_Dirty, 1, sizeof(VRAM_Dirty));
+      ForgetDrawnBlocks();
       RecalcBrightnessCache();
       for(i = 0; i < 4; i++)
       {
@@ -1529,6 +2410,16 @@ int VIP_StateAction(StateMem *sm, int load, int data_only)
    return(ret);
 }
 
+uint8 *VIP_GetVRAM(void)
+{
+   return (uint8 *)VRAM;
+}
+
+uint8 *VIP_GetVRAMDirty(void)
+{
+   return VRAM_Dirty;
+}
+
 uint32 VIP_GetRegister(const unsigned int id, char *special, const uint32 special_len)
 {
    switch(id)
@@ -1575,6 +2466,8 @@ uint32 VIP_GetRegister(const unsigned int id, char *special, const uint32 specia
 
 void VIP_SetRegister(const unsigned int id, const uint32 value)
 {
+   DrawThreadJoin();
+
    switch(id)
    {
       case VIP_GSREG_IPENDING:
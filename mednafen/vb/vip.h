@@ -40,7 +40,11 @@ enum
  VIP_GSREG_BKCOL
 };
 
-bool VIP_Init(void) MDFN_COLD;
+#define VIP_VRAM_SIZE		0x40000
+#define VIP_VRAM_DIRTY_SHIFT	4	/* One dirty flag per character(or per 8 BG map cells) */
+
+bool VIP_Init(void) MDFN_COLD;	/* Returns false if the world cache couldn't be allocated; the VIP still works */
+void VIP_Kill(void) MDFN_COLD;	/* Stops the drawing threads and frees what VIP_Init() allocated */
 void VIP_Power(void) MDFN_COLD;
 
 void VIP_SetInstantDisplayHack(bool);
@@ -49,6 +53,9 @@ void VIP_Set3DMode(uint32 mode, bool reverse, uint32 prescale, uint32 sbs_separa
 void VIP_SetParallaxDisable(bool disabled);
 void VIP_SetDefaultColor(uint32 default_color);
 void VIP_SetAnaglyphColors(uint32 lcolor, uint32 rcolor);	/* R << 16, G << 8, B << 0 */
+void VIP_SetCPUFeatures(uint64 features);	/* RETRO_SIMD_*, picks the drawing code to use */
+bool VIP_SetDrawThread(bool enabled);	/* Draws on a separate thread if enabled; returns whether it is */
+bool VIP_SetEyeThread(bool enabled);	/* Draws the right eye on a thread of its own if enabled; returns whether it is */
 
 v810_timestamp_t MDFN_FASTCALL VIP_Update(const v810_timestamp_t timestamp);
 void VIP_ResetTS(void);
@@ -63,6 +70,11 @@ void VIP_Write16(v810_timestamp_t timestamp, uint32 A, uint16 V);
 
 int VIP_StateAction(StateMem *sm, int load, int data_only);
 
+/* VRAM(frame buffers, CHR RAM and DRAM, 0x00000-0x3FFFF), for mapping it straight into the CPU,
+ * and its dirty flags, which CPU writes must set. */
+uint8 *VIP_GetVRAM(void);
+uint8 *VIP_GetVRAMDirty(void);
+
 uint32 VIP_GetRegister(const unsigned int id, char *special, const uint32 special_len);
 void VIP_SetRegister(const unsigned int id, const uint32 value);
 